@@ -0,0 +1,253 @@
+#ifndef ADAPTIVE_SORT_CPP
+#define ADAPTIVE_SORT_CPP
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// A stable, run-adaptive merge sort in the style of TimSort. The array is
+// scanned for runs that are already ascending (or strictly descending, which
+// are reversed in place); runs shorter than a minimum length are extended
+// with binary insertion sort. Runs are merged as they are found, keeping the
+// stack of pending runs balanced, and each merge first gallops past the
+// elements that are already in place and then only moves the smaller of the
+// two remaining halves into scratch space. Inside a merge, once one side wins
+// several times in a row the merge gallops through it instead of comparing
+// element by element.
+//
+// Sorted input is a single run and costs n - 1 comparisons and no scratch.
+template <typename T> struct AdaptiveSort {
+  static void sort(T *data, int n) {
+    if (n < 2) {
+      return;
+    }
+
+    std::vector<T> scratch;
+    std::vector<Run> runs;
+    int min_length = min_run(n);
+
+    for (int i = 0; i < n;) {
+      int length = count_run(data + i, n - i);
+      if (length < min_length) {
+        int forced = std::min(min_length, n - i);
+        insertion_sort(data + i, forced, length);
+        length = forced;
+      }
+
+      Run run = {i, length};
+      runs.push_back(run);
+      collapse(data, runs, scratch);
+      i += length;
+    }
+
+    while (runs.size() > 1) {
+      int at = runs.size() - 2;
+      if (at > 0 && runs[at - 1].length < runs[at + 1].length) {
+        at -= 1;
+      }
+      merge_at(data, runs, at, scratch);
+    }
+  }
+
+private:
+  struct Run {
+    int base;
+    int length;
+  };
+
+  struct Less {
+    bool operator()(const T &lhs, const T &rhs) const { return lhs < rhs; }
+  };
+
+  // Merging from the back is a forward merge over reversed ranges with the
+  // comparison flipped.
+  struct Greater {
+    bool operator()(const T &lhs, const T &rhs) const { return rhs < lhs; }
+  };
+
+  static const int gallop_threshold = 7;
+
+  // Picks a run length in [32, 64] such that n / length is, or is just below,
+  // a power of two, so the final merges are balanced.
+  static int min_run(int n) {
+    int odd = 0;
+    while (n >= 64) {
+      odd |= n & 1;
+      n >>= 1;
+    }
+    return n + odd;
+  }
+
+  static int count_run(T *data, int n) {
+    if (n == 1) {
+      return 1;
+    }
+
+    int end = 2;
+    if (data[1] < data[0]) {
+      while (end < n && data[end] < data[end - 1]) {
+        end += 1;
+      }
+      std::reverse(data, data + end);
+    } else {
+      while (end < n && !(data[end] < data[end - 1])) {
+        end += 1;
+      }
+    }
+    return end;
+  }
+
+  // Sorts data[0, n) given that data[0, sorted) is already sorted.
+  static void insertion_sort(T *data, int n, int sorted) {
+    for (int i = sorted; i < n; i++) {
+      T value = std::move(data[i]);
+      T *position = std::upper_bound(data, data + i, value);
+      std::move_backward(position, data + i, data + i + 1);
+      *position = std::move(value);
+    }
+  }
+
+  // Keeps the run lengths on the stack decreasing at least as fast as the
+  // Fibonacci numbers, so the stack stays logarithmic and merges stay
+  // balanced.
+  static void collapse(T *data, std::vector<Run> &runs,
+                       std::vector<T> &scratch) {
+    while (runs.size() > 1) {
+      int at = runs.size() - 2;
+      if ((at > 0 &&
+           runs[at - 1].length <= runs[at].length + runs[at + 1].length) ||
+          (at > 1 &&
+           runs[at - 2].length <= runs[at - 1].length + runs[at].length)) {
+        if (runs[at - 1].length < runs[at + 1].length) {
+          at -= 1;
+        }
+      } else if (runs[at].length > runs[at + 1].length) {
+        break;
+      }
+      merge_at(data, runs, at, scratch);
+    }
+  }
+
+  // Merges runs at and at + 1.
+  static void merge_at(T *data, std::vector<Run> &runs, int at,
+                       std::vector<T> &scratch) {
+    T *a = data + runs[at].base;
+    int a_length = runs[at].length;
+    T *b = data + runs[at + 1].base;
+    int b_length = runs[at + 1].length;
+
+    runs[at].length += b_length;
+    runs.erase(runs.begin() + at + 1);
+
+    // Elements of a that are not greater than b[0], and elements of b that
+    // are not less than a's last element, are already where they belong.
+    const T &b_first = b[0];
+    int skip = gallop(a, a_length,
+                      [&](const T &x) { return !(b_first < x); });
+    a += skip;
+    a_length -= skip;
+    if (a_length == 0) {
+      return;
+    }
+
+    const T &a_last = a[a_length - 1];
+    b_length = gallop(b, b_length, [&](const T &x) { return x < a_last; });
+    if (b_length == 0) {
+      return;
+    }
+
+    scratch.clear();
+    if (a_length <= b_length) {
+      std::move(a, a + a_length, std::back_inserter(scratch));
+      merge(scratch.data(), a_length, b, b_length, a, Less());
+    } else {
+      std::move(b, b + b_length, std::back_inserter(scratch));
+      typedef std::reverse_iterator<T *> Reverse;
+      merge(Reverse(scratch.data() + b_length), b_length, Reverse(a + a_length),
+            a_length, Reverse(b + b_length), Greater());
+    }
+  }
+
+  // Merges the buffered run, which comes first, with the run at second into
+  // out. out trails second by exactly the unmerged part of the buffer, so
+  // writes never overtake unread elements. Ties go to the buffered run.
+  template <typename Buffer, typename Iterator, typename Compare>
+  static void merge(Buffer buffer, int buffer_length, Iterator second,
+                    int second_length, Iterator out, Compare less) {
+    int i = 0;
+    int j = 0;
+
+    while (i < buffer_length && j < second_length) {
+      // One element at a time until one side wins often enough...
+      int buffer_wins = 0;
+      int second_wins = 0;
+      while (i < buffer_length && j < second_length &&
+             buffer_wins < gallop_threshold && second_wins < gallop_threshold) {
+        if (less(second[j], buffer[i])) {
+          *out++ = std::move(second[j++]);
+          second_wins += 1;
+          buffer_wins = 0;
+        } else {
+          *out++ = std::move(buffer[i++]);
+          buffer_wins += 1;
+          second_wins = 0;
+        }
+      }
+
+      // ...then in blocks, for as long as the blocks stay long.
+      while (i < buffer_length && j < second_length) {
+        const T &next_second = second[j];
+        int from_buffer =
+            gallop(buffer + i, buffer_length - i,
+                   [&](const T &x) { return !less(next_second, x); });
+        out = std::move(buffer + i, buffer + i + from_buffer, out);
+        i += from_buffer;
+        if (i == buffer_length) {
+          break;
+        }
+
+        const T &next_buffer = buffer[i];
+        int from_second =
+            gallop(second + j, second_length - j,
+                   [&](const T &x) { return less(x, next_buffer); });
+        out = std::move(second + j, second + j + from_second, out);
+        j += from_second;
+
+        if (from_buffer < gallop_threshold && from_second < gallop_threshold) {
+          break;
+        }
+      }
+    }
+
+    // Whatever is left of second is already in place.
+    std::move(buffer + i, buffer + buffer_length, out);
+  }
+
+  // Returns how many leading elements satisfy before, which must hold for a
+  // prefix of the range and nowhere after it. Probes at exponentially growing
+  // offsets first, so a short prefix is found in time logarithmic in its own
+  // length rather than the range's.
+  template <typename Iterator, typename Predicate>
+  static int gallop(Iterator base, int n, Predicate before) {
+    int lo = 0;
+    int offset = 1;
+    while (offset <= n && before(base[offset - 1])) {
+      lo = offset;
+      offset = offset * 2 + 1;
+    }
+
+    int hi = std::min(offset, n);
+    while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (before(base[mid])) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+};
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef ALLOCATORS_CPP
+#define ALLOCATORS_CPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+#include <vector>
+
+// Allocators for CircularDynamicArray's Allocator parameter.
+//
+// ArenaAllocator hands out memory from a MonotonicArena: allocation bumps a
+// pointer, deallocation does nothing, and everything is released at once when
+// the arena is released or destroyed. PoolAllocator keeps freed blocks in
+// per-thread free lists by power-of-two size, which matches the capacities
+// CircularDynamicArray asks for. HugePageAllocator backs large buffers with
+// transparent huge pages.
+
+static const size_t huge_page_size = 2 << 20;
+
+inline size_t huge_page_round(size_t size) {
+  return (size + huge_page_size - 1) & ~(huge_page_size - 1);
+}
+
+// Maps size bytes of anonymous memory, rounded up to whole huge pages and
+// aligned to a huge page boundary, and asks for it to be backed by huge pages.
+// The kernel can only use a huge page for an aligned 2MB extent, so the
+// mapping is made a huge page larger than needed and trimmed to the aligned
+// part. The hint is advisory, so failure to get huge pages is not an error.
+inline void *huge_page_allocate(size_t size) {
+  size = huge_page_round(size);
+  size_t mapped = size + huge_page_size;
+  void *p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+
+  char *first = static_cast<char *>(p);
+  char *aligned = reinterpret_cast<char *>(
+      huge_page_round(reinterpret_cast<uintptr_t>(first)));
+  size_t head = aligned - first;
+  if (head > 0) {
+    munmap(first, head);
+  }
+  munmap(aligned + size, mapped - head - size);
+
+#ifdef MADV_HUGEPAGE
+  madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+  return aligned;
+}
+
+// size is the size passed to huge_page_allocate.
+inline void huge_page_deallocate(void *p, size_t size) {
+  munmap(p, huge_page_round(size));
+}
+
+class MonotonicArena {
+public:
+  // Chunks are at least chunk_size bytes. With huge_pages they are mapped
+  // with huge_page_allocate and rounded up to a whole huge page.
+  MonotonicArena(size_t chunk_size = 64 << 10, bool huge_pages = false)
+      : m_chunk_size(chunk_size), m_huge_pages(huge_pages), m_current(nullptr),
+        m_remaining(0) {}
+
+  MonotonicArena(const MonotonicArena &) = delete;
+  MonotonicArena &operator=(const MonotonicArena &) = delete;
+
+  ~MonotonicArena() { release(); }
+
+  void *allocate(size_t size, size_t alignment) {
+    size_t padding = -reinterpret_cast<uintptr_t>(m_current) & (alignment - 1);
+    if (padding + size > m_remaining) {
+      add_chunk(size + alignment);
+      padding = -reinterpret_cast<uintptr_t>(m_current) & (alignment - 1);
+    }
+
+    void *p = m_current + padding;
+    m_current += padding + size;
+    m_remaining -= padding + size;
+    return p;
+  }
+
+  // Frees every chunk. Memory handed out before is no longer valid.
+  void release() {
+    for (size_t i = 0; i < m_chunks.size(); i++) {
+      if (m_huge_pages) {
+        huge_page_deallocate(m_chunks[i].data, m_chunks[i].size);
+      } else {
+        ::operator delete(m_chunks[i].data);
+      }
+    }
+    m_chunks.clear();
+    m_current = nullptr;
+    m_remaining = 0;
+  }
+
+private:
+  struct Chunk {
+    char *data;
+    size_t size;
+  };
+
+  void add_chunk(size_t minimum) {
+    Chunk chunk;
+    chunk.size = minimum > m_chunk_size ? minimum : m_chunk_size;
+    if (m_huge_pages) {
+      chunk.size = huge_page_round(chunk.size);
+      chunk.data = static_cast<char *>(huge_page_allocate(chunk.size));
+    } else {
+      chunk.data = static_cast<char *>(::operator new(chunk.size));
+    }
+    m_chunks.push_back(chunk);
+
+    m_current = chunk.data;
+    m_remaining = chunk.size;
+  }
+
+  std::vector<Chunk> m_chunks;
+  size_t m_chunk_size;
+  bool m_huge_pages;
+
+  char *m_current;
+  size_t m_remaining;
+};
+
+template <typename T> class ArenaAllocator {
+public:
+  typedef T value_type;
+
+  ArenaAllocator(MonotonicArena &arena) : m_arena(&arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : m_arena(other.arena()) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(m_arena->allocate(sizeof(T) * n, alignof(T)));
+  }
+
+  void deallocate(T *, size_t) {}
+
+  MonotonicArena *arena() const { return m_arena; }
+
+  template <typename U> bool operator==(const ArenaAllocator<U> &rhs) const {
+    return m_arena == rhs.arena();
+  }
+  template <typename U> bool operator!=(const ArenaAllocator<U> &rhs) const {
+    return m_arena != rhs.arena();
+  }
+
+private:
+  MonotonicArena *m_arena;
+};
+
+// The free lists behind PoolAllocator. Blocks freed on one thread are reused
+// by that thread, whichever thread allocated them, so no locking is needed.
+// A thread must not free pool memory after its thread_locals are destroyed.
+class ThreadLocalPool {
+public:
+  static void *allocate(size_t size) {
+    int size_class = class_of(size);
+    if (size_class >= classes) {
+      return ::operator new(size);
+    }
+
+    std::vector<void *> &free = lists().free[size_class];
+    if (free.empty()) {
+      return ::operator new(size_t(1) << size_class);
+    }
+    void *p = free.back();
+    free.pop_back();
+    return p;
+  }
+
+  static void deallocate(void *p, size_t size) {
+    int size_class = class_of(size);
+    if (size_class >= classes) {
+      ::operator delete(p);
+      return;
+    }
+
+    std::vector<void *> &free = lists().free[size_class];
+    if (free.size() >= max_free) {
+      ::operator delete(p);
+      return;
+    }
+    free.push_back(p);
+  }
+
+private:
+  // Size classes are powers of two from 64 bytes to 1MB.
+  static const int min_class = 6;
+  static const int classes = 21;
+  static const size_t max_free = 64;
+
+  struct Lists {
+    ~Lists() {
+      for (int i = 0; i < classes; i++) {
+        for (size_t j = 0; j < free[i].size(); j++) {
+          ::operator delete(free[i][j]);
+        }
+      }
+    }
+
+    std::vector<void *> free[classes];
+  };
+
+  static Lists &lists() {
+    static thread_local Lists lists;
+    return lists;
+  }
+
+  static int class_of(size_t size) {
+    int size_class = min_class;
+    while ((size_t(1) << size_class) < size) {
+      size_class += 1;
+    }
+    return size_class;
+  }
+};
+
+template <typename T> class PoolAllocator {
+public:
+  typedef T value_type;
+
+  PoolAllocator() {}
+  template <typename U> PoolAllocator(const PoolAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(ThreadLocalPool::allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T *p, size_t n) {
+    ThreadLocalPool::deallocate(p, sizeof(T) * n);
+  }
+
+  template <typename U> bool operator==(const PoolAllocator<U> &) const {
+    return true;
+  }
+  template <typename U> bool operator!=(const PoolAllocator<U> &) const {
+    return false;
+  }
+};
+
+// Buffers of at least threshold bytes are mapped with huge pages; smaller
+// ones come from the global heap.
+template <typename T> class HugePageAllocator {
+public:
+  typedef T value_type;
+
+  HugePageAllocator(size_t threshold = huge_page_size)
+      : m_threshold(threshold) {}
+
+  template <typename U>
+  HugePageAllocator(const HugePageAllocator<U> &other)
+      : m_threshold(other.threshold()) {}
+
+  T *allocate(size_t n) {
+    size_t size = sizeof(T) * n;
+    if (size >= m_threshold) {
+      return static_cast<T *>(huge_page_allocate(size));
+    }
+    return static_cast<T *>(::operator new(size));
+  }
+
+  void deallocate(T *p, size_t n) {
+    size_t size = sizeof(T) * n;
+    if (size >= m_threshold) {
+      huge_page_deallocate(p, size);
+    } else {
+      ::operator delete(p);
+    }
+  }
+
+  size_t threshold() const { return m_threshold; }
+
+  template <typename U>
+  bool operator==(const HugePageAllocator<U> &rhs) const {
+    return m_threshold == rhs.threshold();
+  }
+  template <typename U>
+  bool operator!=(const HugePageAllocator<U> &rhs) const {
+    return m_threshold != rhs.threshold();
+  }
+
+private:
+  size_t m_threshold;
+};
+
+#endif
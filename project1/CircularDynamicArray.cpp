@@ -1,248 +1,1492 @@
+#ifndef CIRCULAR_DYNAMIC_ARRAY_CPP
+#define CIRCULAR_DYNAMIC_ARRAY_CPP
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cerrno>
 #include <cstdlib>
-#include <iostream>
+#include <cstring>
+#include <fcntl.h>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
 #include <sys/select.h>
+#include <sys/uio.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "AdaptiveSort.cpp"
+#include "Allocators.cpp"
+#include "RadixSort.cpp"
+#include "RingCapacity.cpp"
+#include "VectorScan.cpp"
+
+// Define CIRCULAR_DYNAMIC_ARRAY_DEBUG before including this file to assert
+// that every operator[], delEnd and delFront is in range. Without it those
+// calls do no checking at all; use at() for an index that may be bad.
+#ifdef CIRCULAR_DYNAMIC_ARRAY_DEBUG
+#define CDA_ASSERT(condition) assert(condition)
+#else
+#define CDA_ASSERT(condition) ((void)0)
+#endif
 
-template <typename T> class CircularDynamicArray {
+// Allocator is any standard allocator for T; Allocators.cpp has arena, pool
+// and huge page allocators.
+template <typename T, typename Allocator = std::allocator<T> >
+class CircularDynamicArray {
 public:
-  CircularDynamicArray() : m_capacity(2), m_length(0), m_start(0) {
-    m_data = new T[m_capacity];
-  }
+  // A contiguous run of live elements.
+  template <typename U> struct Span {
+    U *data;
+    int length;
+
+    U *begin() const { return data; }
+    U *end() const { return data + length; }
+  };
+
+  // The live elements in order: all of first, then all of second. second is
+  // empty unless the ring wraps around the end of the buffer.
+  template <typename U> struct Segments {
+    Span<U> first;
+    Span<U> second;
+  };
+
+  template <typename U> class Iterator {
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef typename std::remove_const<U>::type value_type;
+    typedef int difference_type;
+    typedef U *pointer;
+    typedef U &reference;
+
+    Iterator() : m_data(nullptr), m_start(0), m_mask(0), m_position(0) {}
+    Iterator(U *data, int start, int mask, int position)
+        : m_data(data), m_start(start), m_mask(mask), m_position(position) {}
+
+    // Allows an iterator to convert to a const_iterator.
+    operator Iterator<const U>() const {
+      return Iterator<const U>(m_data, m_start, m_mask, m_position);
+    }
+
+    U &operator*() const { return m_data[(m_start + m_position) & m_mask]; }
+    U *operator->() const { return &**this; }
+    U &operator[](int n) const {
+      return m_data[(m_start + m_position + n) & m_mask];
+    }
 
-  CircularDynamicArray(int size)
-      : m_capacity(size), m_length(size), m_start(0) {
-    m_data = new T[m_capacity];
+    Iterator &operator++() {
+      m_position += 1;
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator old = *this;
+      m_position += 1;
+      return old;
+    }
+    Iterator &operator--() {
+      m_position -= 1;
+      return *this;
+    }
+    Iterator operator--(int) {
+      Iterator old = *this;
+      m_position -= 1;
+      return old;
+    }
+
+    Iterator &operator+=(int n) {
+      m_position += n;
+      return *this;
+    }
+    Iterator &operator-=(int n) {
+      m_position -= n;
+      return *this;
+    }
+    Iterator operator+(int n) const { return Iterator(*this) += n; }
+    Iterator operator-(int n) const { return Iterator(*this) -= n; }
+    friend Iterator operator+(int n, const Iterator &it) { return it + n; }
+    friend int operator-(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position - rhs.m_position;
+    }
+
+    friend bool operator==(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position == rhs.m_position;
+    }
+    friend bool operator!=(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position != rhs.m_position;
+    }
+    friend bool operator<(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position < rhs.m_position;
+    }
+    friend bool operator>(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position > rhs.m_position;
+    }
+    friend bool operator<=(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position <= rhs.m_position;
+    }
+    friend bool operator>=(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position >= rhs.m_position;
+    }
+
+  private:
+    U *m_data;
+    int m_start;
+    int m_mask;
+    int m_position;
+  };
+
+  typedef Iterator<T> iterator;
+  typedef Iterator<const T> const_iterator;
+
+  // How the capacity follows the length. Capacities are powers of two, so
+  // growth multiplies the capacity by 2^growth_shift. Removing an element
+  // halves the capacity once it is at least shrink_ratio times the length,
+  // leaving room to grow again before the next reallocation, but never below
+  // min_capacity. A shrink_ratio of 0 never shrinks. growth_shift must be in
+  // [1, 30], a nonzero shrink_ratio at least 3 so that a halved buffer is
+  // never full, and min_capacity at most 2^30.
+  struct GrowthPolicy {
+    GrowthPolicy(int growth_shift = 1, int shrink_ratio = 4,
+                 int min_capacity = 2)
+        : growth_shift(growth_shift), shrink_ratio(shrink_ratio),
+          min_capacity(min_capacity) {}
+
+    int growth_shift;
+    int shrink_ratio;
+    int min_capacity;
+  };
+
+  CircularDynamicArray() : CircularDynamicArray(Allocator()) {}
+
+  explicit CircularDynamicArray(const Allocator &allocator)
+      : CircularDynamicArray(Reserved(), 2, allocator) {}
+
+  CircularDynamicArray(int size, const Allocator &allocator = Allocator())
+      : CircularDynamicArray(Reserved(), round_capacity(size), allocator) {
+    for (int i = 0; i < size; i++) {
+      construct_end();
+    }
   }
 
+  // Keeps old's capacity and start, so every element lands in the same slot.
   CircularDynamicArray(const CircularDynamicArray &old)
-      : m_capacity(old.m_capacity), m_length(old.m_length),
-        m_start(old.m_start) {
-    m_data = new T[m_capacity];
+      : CircularDynamicArray(
+            Reserved(), old.m_capacity,
+            AllocatorTraits::select_on_container_copy_construction(
+                old.m_allocator)) {
+    m_policy = old.m_policy;
+    m_start = old.m_start;
+    for (int i = 0; i < old.m_length; i++) {
+      construct_end(old.m_data[old.internal_index(i)]);
+    }
+  }
 
-    for (int i = 0; i < m_length; i++) {
-      int index = internal_index(i);
-      m_data[index] = old.m_data[index];
+  // Forward iterators are counted first so the buffer is allocated once;
+  // single-pass input iterators are appended one element at a time.
+  template <typename Iterator,
+            typename = typename std::enable_if<
+                !std::is_integral<Iterator>::value>::type>
+  CircularDynamicArray(Iterator first, Iterator last,
+                       const Allocator &allocator = Allocator())
+      : CircularDynamicArray(
+            Reserved(),
+            range_capacity(first, last,
+                           typename std::iterator_traits<
+                               Iterator>::iterator_category()),
+            allocator) {
+    for (; first != last; ++first) {
+      emplaceEnd(*first);
     }
   }
 
+  CircularDynamicArray(CircularDynamicArray &&old) noexcept
+      : m_data(old.m_data), m_capacity(old.m_capacity),
+        m_length(old.m_length), m_start(old.m_start),
+        m_policy(old.m_policy), m_allocator(std::move(old.m_allocator)) {
+    old.m_data = nullptr;
+    old.m_capacity = 0;
+    old.m_length = 0;
+    old.m_start = 0;
+  }
+
+  // Assignment keeps this array's allocator, and its buffer too when rhs fits
+  // in it; rhs is then copied in unwrapped from index 0.
   CircularDynamicArray &operator=(const CircularDynamicArray &rhs) {
     if (this == &rhs) {
       return *this;
     }
 
-    delete[] m_data;
+    destroy_all();
+    m_length = 0;
+    m_policy = rhs.m_policy;
 
+    if (m_data != nullptr && rhs.m_length <= m_capacity) {
+      m_start = 0;
+      if (rhs.m_length > 0) {
+        Segments<const T> from = rhs.segments();
+        copy_into(0, from.first.data, from.first.length);
+        m_length = from.first.length;
+        copy_into(from.first.length, from.second.data, from.second.length);
+      }
+      m_length = rhs.m_length;
+      return *this;
+    }
+
+    // Left empty, with no buffer, if allocating or copying throws.
+    deallocate(m_data, m_capacity);
+    m_data = nullptr;
+    m_capacity = 0;
+    m_start = 0;
+
+    m_data = allocate(rhs.m_capacity);
+    m_capacity = rhs.m_capacity;
+    m_start = rhs.m_start;
+    for (int i = 0; i < rhs.m_length; i++) {
+      construct_end(rhs.m_data[rhs.internal_index(i)]);
+    }
+
+    return *this;
+  }
+
+  // Move assignment takes over rhs's buffer, and so its allocator too.
+  CircularDynamicArray &operator=(CircularDynamicArray &&rhs) noexcept {
+    if (this == &rhs) {
+      return *this;
+    }
+
+    destroy_all();
+    deallocate(m_data, m_capacity);
+
+    m_data = rhs.m_data;
     m_start = rhs.m_start;
     m_length = rhs.m_length;
     m_capacity = rhs.m_capacity;
-    m_data = new T[m_capacity];
+    m_policy = rhs.m_policy;
+    m_allocator = std::move(rhs.m_allocator);
 
-    for (int i = 0; i < m_length; i++) {
-      int index = internal_index(i);
-      m_data[index] = rhs.m_data[index];
-    }
+    rhs.m_data = nullptr;
+    rhs.m_capacity = 0;
+    rhs.m_length = 0;
+    rhs.m_start = 0;
 
     return *this;
   }
 
-  ~CircularDynamicArray() { delete[] m_data; }
+  ~CircularDynamicArray() {
+    destroy_all();
+    deallocate(m_data, m_capacity);
+  }
 
   T &operator[](int i) {
-    if (i >= m_length) {
-      std::cout << "invalid index " << i << " when the length is " << m_length
-                << std::endl;
-      return dummy;
-    }
+    CDA_ASSERT(i >= 0 && i < m_length);
+    return m_data[internal_index(i)];
+  }
+  const T &operator[](int i) const {
+    CDA_ASSERT(i >= 0 && i < m_length);
+    return m_data[internal_index(i)];
+  }
 
-    int index = internal_index(i);
-    return m_data[index];
+  // Throws std::out_of_range if i is not in [0, length()).
+  T &at(int i) {
+    check_index(i);
+    return m_data[internal_index(i)];
   }
+  const T &at(int i) const {
+    check_index(i);
+    return m_data[internal_index(i)];
+  }
+
+  void addEnd(const T &v) { emplaceEnd(v); }
+  void addEnd(T &&v) { emplaceEnd(std::move(v)); }
+
+  void addFront(const T &v) { emplaceFront(v); }
+  void addFront(T &&v) { emplaceFront(std::move(v)); }
 
-  void addEnd(T v) {
+  template <typename... Args> T &emplaceEnd(Args &&...args) {
     if (m_length == m_capacity) {
-      resize(m_capacity * 2);
+      // The arguments may refer into the current buffer, so build the value
+      // before growing and move it into place afterwards.
+      T value(std::forward<Args>(args)...);
+      grow();
+      return construct_end(std::move(value));
     }
-
-    int index = (m_start + m_length) % m_capacity;
-    m_data[index] = v;
-    m_length += 1;
+    return construct_end(std::forward<Args>(args)...);
   }
 
-  void addFront(T v) {
+  template <typename... Args> T &emplaceFront(Args &&...args) {
     if (m_length == m_capacity) {
-      resize(m_capacity * 2);
+      T value(std::forward<Args>(args)...);
+      grow();
+      return construct_front(std::move(value));
     }
+    return construct_front(std::forward<Args>(args)...);
+  }
 
-    int index = (m_start - 1) % m_capacity;
-    if (index == -1) {
-      index = m_capacity - 1;
-    }
-    m_data[index] = v;
-    m_start = index;
-    m_length += 1;
+  // Copies n values onto the end (or front) of the array in order, growing at
+  // most once. The values must not live inside this array.
+  void appendRange(const T *values, int n) {
+    ensure_capacity(m_length + n);
+
+    int first = internal_index(m_length);
+    int count = std::min(n, m_capacity - first);
+    copy_into(first, values, count);
+    copy_into(0, values + count, n - count);
+    m_length += n;
+  }
+
+  void prependRange(const T *values, int n) {
+    ensure_capacity(m_length + n);
+
+    int first = internal_index(-n);
+    int count = std::min(n, m_capacity - first);
+    copy_into(first, values, count);
+    copy_into(0, values + count, n - count);
+    m_start = first;
+    m_length += n;
   }
 
   void delEnd() {
+    CDA_ASSERT(m_length > 0);
     m_length -= 1;
-    if (m_length == 0) {
-      return;
-    }
-
-    if (m_length != 0 && (m_capacity / m_length) >= 4) {
-      resize(m_capacity / 2);
-    }
+    m_data[internal_index(m_length)].~T();
+    shrink_if_sparse();
   }
 
   void delFront() {
-    m_start = (m_start + 1) % m_capacity;
+    CDA_ASSERT(m_length > 0);
+    m_data[m_start].~T();
+    m_start = internal_index(1);
     m_length -= 1;
-    if (m_length == 0) {
-      return;
+    shrink_if_sparse();
+  }
+
+  int length() const { return m_length; }
+  int capacity() const { return m_capacity; }
+  Allocator allocator() const { return m_allocator; }
+
+  const GrowthPolicy &growthPolicy() const { return m_policy; }
+
+  // Throws std::invalid_argument if policy breaks the rules above.
+  void setGrowthPolicy(const GrowthPolicy &policy) {
+    if (policy.growth_shift < 1 || policy.growth_shift > 30) {
+      throw std::invalid_argument("growth_shift must be in [1, 30]");
+    }
+    if (policy.shrink_ratio < 0 ||
+        (policy.shrink_ratio > 0 && policy.shrink_ratio < 3)) {
+      throw std::invalid_argument("shrink_ratio must be 0 or at least 3");
     }
+    if (policy.min_capacity > max_capacity) {
+      throw std::invalid_argument("min_capacity must be at most 2^30");
+    }
+    m_policy = policy;
+  }
 
-    if ((m_capacity / m_length) == 4) {
-      resize(m_capacity / 2);
+  // Makes room for at least size elements without further reallocation.
+  // Shrinking can still release it unless the policy prevents that. Throws
+  // std::length_error if size is over 2^30, as does every way of growing the
+  // array past that.
+  void reserve(int size) { ensure_capacity(size); }
+
+  // Releases unused capacity down to the smallest power of two that holds the
+  // elements, or the policy's minimum capacity.
+  void shrinkToFit() {
+    int size = round_capacity(std::max(m_length, m_policy.min_capacity));
+    if (size < m_capacity) {
+      resize(size);
     }
   }
 
-  int length() const { return m_length; }
-  int capacity() const { return m_capacity; }
+  Segments<T> segments() { return make_segments<T>(m_data); }
+  Segments<const T> segments() const { return make_segments<const T>(m_data); }
 
-  void clear() {
-    delete[] m_data;
+  iterator begin() { return iterator(m_data, m_start, m_capacity - 1, 0); }
+  iterator end() {
+    return iterator(m_data, m_start, m_capacity - 1, m_length);
+  }
+  const_iterator begin() const {
+    return const_iterator(m_data, m_start, m_capacity - 1, 0);
+  }
+  const_iterator end() const {
+    return const_iterator(m_data, m_start, m_capacity - 1, m_length);
+  }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
 
-    m_data = new T[2];
-    m_capacity = 2;
+  // Empties the array, keeping the buffer when it is already the minimum
+  // capacity.
+  void clear() {
+    destroy_all();
     m_length = 0;
     m_start = 0;
+
+    int size = round_capacity(m_policy.min_capacity);
+    if (m_capacity != size) {
+      deallocate(m_data, m_capacity);
+      m_data = allocate(size);
+      m_capacity = size;
+    }
   }
 
+  // Returns the k-th smallest element, counting from 1. The array is
+  // reordered.
   T QSelect(int k) { return select(0, m_length - 1, k - 1); }
 
-  T select(uint left, uint right, int k) {
-    if (left == right) {
-      return index(left);
+  // Sets out[i] to the ks[i]-th smallest element for each of the count
+  // queries. The queries share partitions, so asking for several percentiles
+  // costs about as much as asking for one.
+  void multiSelect(const int ks[], int count, T out[]) {
+    linearize();
+    T *data = m_data + m_start;
+
+    std::vector<int> sorted(ks, ks + count);
+    std::sort(sorted.begin(), sorted.end());
+
+    struct Range {
+      int left;
+      int right;
+      int first;
+      int last;
+      int budget;
+    };
+    std::vector<Range> ranges;
+    Range all = {0, m_length - 1, 0, count, select_budget(m_length)};
+    ranges.push_back(all);
+
+    while (!ranges.empty()) {
+      Range range = ranges.back();
+      ranges.pop_back();
+
+      if (range.first == range.last) {
+        continue;
+      }
+      if (range.last - range.first == 1) {
+        select_in(data, range.left, range.right, sorted[range.first] - 1,
+                  range.budget);
+        continue;
+      }
+      if (range.right - range.left < select_cutoff) {
+        insertion_sort(data, range.left, range.right);
+        continue;
+      }
+
+      int lt, gt;
+      T pivot = select_pivot(data, range.left, range.right, range.budget);
+      partition(data, range.left, range.right, pivot, lt, gt);
+
+      int below = range.first;
+      while (below < range.last && sorted[below] - 1 < lt) {
+        below += 1;
+      }
+      int above = below;
+      while (above < range.last && sorted[above] - 1 <= gt) {
+        above += 1;
+      }
+
+      Range left = {range.left, lt - 1, range.first, below, range.budget - 1};
+      Range right = {gt + 1, range.right, above, range.last, range.budget - 1};
+      ranges.push_back(left);
+      ranges.push_back(right);
     }
-    uint pivot_index = left + std::rand() % (right - left + 1);
-    pivot_index = partition(left, right, pivot_index);
 
-    if (k == pivot_index) {
-      return index(k);
-    } else if (k < pivot_index) {
-      return select(left, pivot_index - 1, k);
-    } else {
-      return select(pivot_index + 1, right, k);
+    // Every queried position now holds its answer, since no range that was
+    // partitioned later contained it.
+    for (int i = 0; i < count; i++) {
+      out[i] = data[ks[i] - 1];
+    }
+  }
+
+  // Returns the element that belongs at index k, looking only at indices
+  // left to right. This is an introselect: random median-of-three pivots and
+  // three-way partitions, falling back to median of medians if the range
+  // stops shrinking.
+  T select(int left, int right, int k) {
+    linearize();
+    T *data = m_data + m_start;
+    select_in(data, left, right, k, select_budget(right - left + 1));
+    return data[k];
+  }
+
+  void swap(uint lhs, uint rhs) {
+    T temp = std::move((*this)[lhs]);
+    (*this)[lhs] = std::move((*this)[rhs]);
+    (*this)[rhs] = std::move(temp);
+  }
+
+  // Integer and floating point arrays are radix sorted; every other T falls
+  // back to AdaptiveSort, which is linear on input that is already sorted and
+  // close to it on input that is nearly so.
+  void Sort() {
+    linearize();
+    sort_run(m_data + m_start, m_length);
+  }
+
+  // Stable sort using up to threads workers, or every core when threads is 0,
+  // but never fewer than sort_share elements per worker. The array is cut
+  // into one run per worker, the runs are sorted concurrently, and then pairs
+  // of runs are merged with every worker taking an equal share of each round's
+  // output. With only one worker this is Sort().
+  void Sort(int threads) {
+    if (threads <= 0) {
+      threads = std::thread::hardware_concurrency();
+    }
+    threads = std::min(threads, m_length / sort_share);
+    if (threads <= 1) {
+      Sort();
+      return;
+    }
+
+    linearize();
+    T *data = m_data + m_start;
+    int n = m_length;
+
+    std::vector<int> runs(threads + 1);
+    for (int i = 0; i <= threads; i++) {
+      runs[i] = (long long)n * i / threads;
+    }
+    parallel_for(threads, [&](int t) {
+      sort_run(data + runs[t], runs[t + 1] - runs[t]);
+    });
+
+    std::vector<T> scratch(std::make_move_iterator(data),
+                           std::make_move_iterator(data + n));
+    T *from = scratch.data();
+    T *to = data;
+
+    std::vector<int> splits(threads + 1);
+    while (runs.size() > 2) {
+      // Split points are found before any worker starts moving elements out
+      // of from, since each search reads outside its worker's share.
+      for (int t = 0; t <= threads; t++) {
+        splits[t] = merge_split(from, runs, (long long)n * t / threads);
+      }
+      parallel_for(threads, [&](int t) {
+        int first = (long long)n * t / threads;
+        int last = (long long)n * (t + 1) / threads;
+        merge_round(from, to, runs, first, last, splits[t], splits[t + 1]);
+      });
+
+      std::vector<int> merged;
+      for (size_t i = 0; i < runs.size() - 1; i += 2) {
+        merged.push_back(runs[i]);
+      }
+      merged.push_back(n);
+      runs.swap(merged);
+      std::swap(from, to);
+    }
+
+    if (from != data) {
+      std::move(from, from + n, data);
     }
   }
 
-  uint partition(uint left, uint right, uint pivot_index) {
-    T pivot_value = index(pivot_index);
-    swap(pivot_index, right);
+  int linearSearch(const T &e) const {
+    Segments<const T> view = segments();
+    int i = VectorScan<T>::find(view.first.data, view.first.length, e);
+    if (i != -1) {
+      return i;
+    }
+    i = VectorScan<T>::find(view.second.data, view.second.length, e);
+    if (i != -1) {
+      return view.first.length + i;
+    }
+    return -1;
+  }
 
-    uint store_index = left;
-    for (uint i = left; i < right; i++) {
-      if (index(i) < pivot_value) {
-        swap(store_index, i);
-        store_index += 1;
+  int count(const T &e) const {
+    Segments<const T> view = segments();
+    return VectorScan<T>::count(view.first.data, view.first.length, e) +
+           VectorScan<T>::count(view.second.data, view.second.length, e);
+  }
+
+  // Returns the index of the first element for which pred is true, or -1.
+  // pred is evaluated over whole blocks without branching so that simple
+  // predicates vectorize, and may be called on elements past the match.
+  template <typename Predicate> int findIf(Predicate pred) const {
+    Segments<const T> view = segments();
+    int i = find_if(view.first, pred);
+    if (i != -1) {
+      return i;
+    }
+    i = find_if(view.second, pred);
+    if (i != -1) {
+      return view.first.length + i;
+    }
+    return -1;
+  }
+
+  // The array must not be empty.
+  T min() const {
+    Segments<const T> view = segments();
+    T best = VectorScan<T>::min(view.first.data, view.first.length);
+    if (view.second.length != 0) {
+      T second = VectorScan<T>::min(view.second.data, view.second.length);
+      if (second < best) {
+        best = second;
       }
     }
+    return best;
+  }
 
-    swap(right, store_index);
-    return store_index;
+  T max() const {
+    Segments<const T> view = segments();
+    T best = VectorScan<T>::max(view.first.data, view.first.length);
+    if (view.second.length != 0) {
+      T second = VectorScan<T>::max(view.second.data, view.second.length);
+      if (best < second) {
+        best = second;
+      }
+    }
+    return best;
   }
 
-  void swap(uint lhs, uint rhs) {
-    T temp = index(lhs);
-    index(lhs) = index(rhs);
-    index(rhs) = temp;
+  // Parallel scans. Each splits the array into one equal share per worker,
+  // with up to threads workers or every core when threads is 0, but never
+  // fewer than scan_share elements per worker, and runs serially when that
+  // leaves one worker. Functions passed in are called from several threads at
+  // once.
+
+  // Folds the elements in order: each worker folds its share into a copy of
+  // identity with accumulate(R, const T &), and the shares are then folded
+  // left to right with combine(R, R). identity must be an identity of combine
+  // and combine must be associative, as with a sum, min or max.
+  template <typename R, typename Accumulate, typename Combine>
+  R reduce(R identity, Accumulate accumulate, Combine combine,
+           int threads = 0) const {
+    threads = scan_threads(threads);
+
+    // Each worker folds into a local and stores it once, so neighbouring
+    // workers never write the same cache line inside the loop. The wrapper
+    // keeps R = bool out of vector<bool>, whose elements share words.
+    struct Partial {
+      R value;
+    };
+    std::vector<Partial> partials(threads, Partial{identity});
+    Segments<const T> view = segments();
+    parallel_for(threads, [&](int t) {
+      R partial = identity;
+      for_each_span(view, share(t, threads), share(t + 1, threads),
+                    [&](const T *data, int, int count) {
+                      for (int i = 0; i < count; i++) {
+                        partial = accumulate(partial, data[i]);
+                      }
+                    });
+      partials[t].value = partial;
+    });
+
+    R result = partials[0].value;
+    for (int t = 1; t < threads; t++) {
+      result = combine(result, partials[t].value);
+    }
+    return result;
   }
 
-  void Sort() {
-    CircularDynamicArray<T> temp(*this);
-    merge_sort(temp, *this, 0, m_length);
+  // Replaces every element e with f(e).
+  template <typename Function>
+  void transform(Function f, int threads = 0) {
+    threads = scan_threads(threads);
+    Segments<T> view = segments();
+    parallel_for(threads, [&](int t) {
+      for_each_span(view, share(t, threads), share(t + 1, threads),
+                    [&](T *data, int, int count) {
+                      for (int i = 0; i < count; i++) {
+                        data[i] = f(data[i]);
+                      }
+                    });
+    });
+  }
+
+  // findIf across workers. The lowest match wins, and a worker stops once a
+  // match has been found before the block it is about to scan.
+  template <typename Predicate>
+  int findFirst(Predicate pred, int threads = 0) const {
+    threads = scan_threads(threads);
+    if (threads == 1) {
+      return findIf(pred);
+    }
+    return find_first(threads, [&](Span<const T> span) {
+      return find_if(span, pred);
+    });
+  }
+
+  // linearSearch across workers, with findFirst's first-match semantics.
+  int linearSearch(const T &e, int threads) const {
+    threads = scan_threads(threads);
+    if (threads == 1) {
+      return linearSearch(e);
+    }
+    return find_first(threads, [&](Span<const T> span) {
+      return VectorScan<T>::find(span.data, span.length, e);
+    });
   }
 
-  void merge_sort(CircularDynamicArray &A, CircularDynamicArray &B, uint start,
-                  uint end) {
-    if (end - start <= 1) {
+  int binSearch(const T &e) const { return found_at(lowerBound(e), e); }
+
+  // binSearch for each of queries[0, n), with the results in out. If the
+  // queries are sorted they are answered in one forward pass that gallops
+  // from each answer to the next. Otherwise batch_width searches run in
+  // lockstep, so the cache misses of one are overlapped with the others.
+  void binSearchBatch(const T *queries, int n, int *out) const {
+    if (std::is_sorted(queries, queries + n)) {
+      int position = 0;
+      for (int q = 0; q < n; q++) {
+        position = gallop_lower_bound(position, queries[q]);
+        out[q] = found_at(position, queries[q]);
+      }
       return;
     }
 
-    uint middle = start + (end - start) / 2;
+    Segments<const T> view = segments();
+    for (int first = 0; first < n; first += batch_width) {
+      int count = n - first < batch_width ? n - first : batch_width;
+      const T *base[batch_width];
+      int length[batch_width];
+      int offset[batch_width];
 
-    merge_sort(B, A, start, middle);
-    merge_sort(B, A, middle, end);
-    merge(A, B, start, middle, end);
+      for (int q = 0; q < count; q++) {
+        const T &e = queries[first + q];
+        bool second = view.second.length != 0 &&
+                      view.first.data[view.first.length - 1] < e;
+        base[q] = second ? view.second.data : view.first.data;
+        length[q] = second ? view.second.length : view.first.length;
+        offset[q] = second ? view.first.length : 0;
+      }
+
+      for (bool active = true; active;) {
+        active = false;
+        for (int q = 0; q < count; q++) {
+          if (length[q] > 1) {
+            int half = length[q] / 2;
+            base[q] = base[q][half] < queries[first + q] ? base[q] + half
+                                                         : base[q];
+            length[q] -= half;
+            __builtin_prefetch(base[q] + length[q] / 2);
+            active = true;
+          }
+        }
+      }
+
+      for (int q = 0; q < count; q++) {
+        const T &e = queries[first + q];
+        const T *start = offset[q] == 0 ? view.first.data : view.second.data;
+        int i = offset[q] + (base[q] - start) +
+                (length[q] != 0 && *base[q] < e);
+        out[first + q] = found_at(i, e);
+      }
+    }
   }
 
-  void merge(CircularDynamicArray &A, CircularDynamicArray &B, uint start,
-             uint middle, uint end) {
-    uint i = start;
-    uint i_len = middle;
+  // The bounds below require the array to be sorted. lowerBound is the index
+  // of the first element not less than e and upperBound the index of the
+  // first element greater than e; both are length() if there is none.
+  int lowerBound(const T &e) const {
+    // Only one of the two segments can hold the boundary, so a single compare
+    // reduces the wrapped case to a search over contiguous memory.
+    Segments<const T> view = segments();
+    if (view.second.length != 0 && view.first.data[view.first.length - 1] < e) {
+      return view.first.length + lower_bound(view.second, e);
+    }
+    return lower_bound(view.first, e);
+  }
 
-    uint j = middle;
-    uint j_len = end;
+  int upperBound(const T &e) const {
+    Segments<const T> view = segments();
+    if (view.second.length != 0 &&
+        !(e < view.first.data[view.first.length - 1])) {
+      return view.first.length + upper_bound(view.second, e);
+    }
+    return upper_bound(view.first, e);
+  }
 
-    for (uint k = start; k < end; k++) {
-      if (i < i_len && (j >= j_len || A[i] <= A[j])) {
-        B[k] = A[i];
+  std::pair<int, int> equalRange(const T &e) const {
+    return std::make_pair(lowerBound(e), upperBound(e));
+  }
+
+  // Binary snapshots, for trivially copyable T only. A snapshot is a header
+  // (magic, format version, element size, length) followed by the elements in
+  // order. save writes the header and both segments with writev, and load
+  // reads the elements straight into a single buffer of the final size, so
+  // either works on pipes and sockets as well as files. Both throw
+  // std::runtime_error on an I/O error or a snapshot of another format, and
+  // load also on one longer than max_capacity.
+  void save(int fd) const {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "save needs a trivially copyable T");
+
+    SnapshotHeader header = {snapshot_magic, snapshot_version, sizeof(T),
+                             (uint64_t)m_length};
+    Segments<const T> view = segments();
+    struct iovec parts[3] = {
+        {&header, sizeof(header)},
+        {const_cast<T *>(view.first.data), sizeof(T) * view.first.length},
+        {const_cast<T *>(view.second.data), sizeof(T) * view.second.length}};
+    write_all(fd, parts, 3);
+  }
+
+  void load(int fd) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "load needs a trivially copyable T");
+
+    SnapshotHeader header;
+    read_all(fd, &header, sizeof(header));
+    if (header.magic != snapshot_magic ||
+        header.version != snapshot_version ||
+        header.element_size != sizeof(T) ||
+        header.length > uint64_t(max_capacity)) {
+      throw std::runtime_error("not a snapshot of this element type");
+    }
+
+    int length = header.length;
+    int size = round_capacity(std::max(length, m_policy.min_capacity));
+    T *data = allocate(size);
+    try {
+      read_all(fd, data, sizeof(T) * length);
+    } catch (...) {
+      deallocate(data, size);
+      throw;
+    }
+
+    deallocate(m_data, m_capacity);
+    m_data = data;
+    m_capacity = size;
+    m_length = length;
+    m_start = 0;
+  }
+
+  void save(const char *path) const {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error(std::string(path) + ": " +
+                               std::strerror(errno));
+    }
+    try {
+      save(fd);
+    } catch (...) {
+      close(fd);
+      throw;
+    }
+    close(fd);
+  }
+
+  void load(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error(std::string(path) + ": " +
+                               std::strerror(errno));
+    }
+    try {
+      load(fd);
+    } catch (...) {
+      close(fd);
+      throw;
+    }
+    close(fd);
+  }
+
+private:
+  // The capacity is always a power of two, so wrapping around the ring is a
+  // mask rather than a division.
+  int internal_index(int i) const { return (m_start + i) & (m_capacity - 1); }
+
+  // Throws std::length_error past max_capacity.
+  static int round_capacity(int size) {
+    return ring_capacity("CircularDynamicArray", size);
+  }
+
+  void check_index(int i) const {
+    if (i < 0 || i >= m_length) {
+      throw std::out_of_range("CircularDynamicArray: index " +
+                              std::to_string(i) + " out of range for length " +
+                              std::to_string(m_length));
+    }
+  }
+
+  template <typename U> Segments<U> make_segments(U *data) const {
+    Segments<U> view;
+    int first = std::min(m_length, m_capacity - m_start);
+    view.first.data = data + m_start;
+    view.first.length = first;
+    view.second.data = data;
+    view.second.length = m_length - first;
+    return view;
+  }
+
+  // Branchless binary searches: each step halves the range with a conditional
+  // move instead of a jump, and prefetches both places the next probe can land
+  // so that the cache miss overlaps the current compare.
+  // The index of the first element not less than e, given that every element
+  // before from is less than e. The probes double in distance from from, so
+  // the cost is logarithmic in how far the answer is rather than in length().
+  int gallop_lower_bound(int from, const T &e) const {
+    int lo = from;
+    int hi = from;
+    int step = 1;
+    while (hi < m_length && m_data[internal_index(hi)] < e) {
+      lo = hi + 1;
+      hi += step;
+      step <<= 1;
+    }
+    if (hi > m_length) {
+      hi = m_length;
+    }
+
+    while (lo < hi) {
+      int middle = lo + (hi - lo) / 2;
+      if (m_data[internal_index(middle)] < e) {
+        lo = middle + 1;
+      } else {
+        hi = middle;
+      }
+    }
+    return lo;
+  }
+
+  // Turns a lower bound for e into binSearch's answer.
+  int found_at(int i, const T &e) const {
+    return i < m_length && !(e < m_data[internal_index(i)]) ? i : -1;
+  }
+
+  static int lower_bound(Span<const T> span, const T &e) {
+    if (span.length == 0) {
+      return 0;
+    }
+
+    const T *base = span.data;
+    int n = span.length;
+    while (n > 1) {
+      int half = n / 2;
+      int next = (n - half) / 2;
+      __builtin_prefetch(base + next);
+      __builtin_prefetch(base + half + next);
+      base = base[half] < e ? base + half : base;
+      n -= half;
+    }
+    return (base - span.data) + (*base < e);
+  }
+
+  static int upper_bound(Span<const T> span, const T &e) {
+    if (span.length == 0) {
+      return 0;
+    }
+
+    const T *base = span.data;
+    int n = span.length;
+    while (n > 1) {
+      int half = n / 2;
+      int next = (n - half) / 2;
+      __builtin_prefetch(base + next);
+      __builtin_prefetch(base + half + next);
+      base = e < base[half] ? base : base + half;
+      n -= half;
+    }
+    return (base - span.data) + !(e < *base);
+  }
+
+  // A sorted array is left alone, which costs one pass instead of at least
+  // two radix passes.
+  // Sorts data[0, n) with RadixSort where T has one, unless it is already
+  // sorted, and with AdaptiveSort otherwise.
+  static void sort_run(T *data, int n) {
+    sort_run(data, n, std::integral_constant<bool, RadixSort<T>::enabled>());
+  }
+
+  static void sort_run(T *data, int n, std::true_type) {
+    if (!std::is_sorted(data, data + n)) {
+      RadixSort<T>::sort(data, n);
+    }
+  }
+
+  static void sort_run(T *data, int n, std::false_type) {
+    AdaptiveSort<T>::sort(data, n);
+  }
+
+  struct SnapshotHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t element_size;
+    uint64_t length;
+  };
+
+  static const uint64_t snapshot_magic = 0x50414e5341444321ull;
+  static const uint32_t snapshot_version = 1;
+
+  // Writes every part, resuming after short writes.
+  static void write_all(int fd, struct iovec *parts, int count) {
+    while (count > 0) {
+      ssize_t written = writev(fd, parts, count);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::runtime_error(std::string("writev: ") +
+                                 std::strerror(errno));
+      }
+
+      while (count > 0 && (size_t)written >= parts->iov_len) {
+        written -= parts->iov_len;
+        parts += 1;
+        count -= 1;
+      }
+      if (count > 0) {
+        parts->iov_base = static_cast<char *>(parts->iov_base) + written;
+        parts->iov_len -= written;
+      }
+    }
+  }
+
+  static void read_all(int fd, void *data, size_t size) {
+    char *p = static_cast<char *>(data);
+    while (size > 0) {
+      ssize_t got = read(fd, p, size);
+      if (got < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::runtime_error(std::string("read: ") + std::strerror(errno));
+      }
+      if (got == 0) {
+        throw std::runtime_error("snapshot is truncated");
+      }
+      p += got;
+      size -= got;
+    }
+  }
+
+  static const int max_capacity = max_ring_capacity;
+  // Every merge round starts its workers afresh, and a round moves each
+  // element once, so a worker's share has to be many times the 20K or so
+  // elements that can be merged in the time it takes to start a thread.
+  static const int sort_share = 1 << 16;
+  static const int batch_width = 16;
+  // Starting and joining a thread costs about as much as summing 50K ints,
+  // so a worker needs several times that to pay for itself.
+  static const int scan_share = 1 << 18;
+  static const int find_block = 1 << 12;
+  static const int select_cutoff = 16;
+
+  // After this many partitions selection switches to median of medians.
+  static int select_budget(int n) {
+    int budget = 0;
+    for (; n > 1; n >>= 1) {
+      budget += 2;
+    }
+    return budget;
+  }
+
+  static void select_in(T *data, int left, int right, int k, int budget) {
+    while (right - left >= select_cutoff) {
+      int lt, gt;
+      T pivot = select_pivot(data, left, right, budget);
+      partition(data, left, right, pivot, lt, gt);
+      budget -= 1;
+
+      if (k < lt) {
+        right = lt - 1;
+      } else if (k > gt) {
+        left = gt + 1;
+      } else {
+        return;
+      }
+    }
+    insertion_sort(data, left, right);
+  }
+
+  static T select_pivot(T *data, int left, int right, int budget) {
+    if (budget <= 0) {
+      return median_of_medians(data, left, right);
+    }
+
+    const T &a = data[random_index(left, right)];
+    const T &b = data[random_index(left, right)];
+    const T &c = data[random_index(left, right)];
+    if (a < b) {
+      return b < c ? b : (a < c ? c : a);
+    }
+    return a < c ? a : (b < c ? c : b);
+  }
+
+  // Gathers the median of each group of five at the front of the range and
+  // selects their median, which is guaranteed to split the range 30/70.
+  static T median_of_medians(T *data, int left, int right) {
+    int medians = left;
+    for (int i = left; i <= right; i += 5) {
+      int last = std::min(i + 4, right);
+      insertion_sort(data, i, last);
+      std::swap(data[medians], data[i + (last - i) / 2]);
+      medians += 1;
+    }
+
+    int middle = left + (medians - left - 1) / 2;
+    select_in(data, left, medians - 1, middle, 0);
+    return data[middle];
+  }
+
+  // Splits the range into [left, lt) less than pivot, [lt, gt] equal to it
+  // and (gt, right] greater, so runs of duplicates are settled in one pass.
+  // The pivot must be one of the elements in the range.
+  static void partition(T *data, int left, int right, const T &pivot, int &lt,
+                        int &gt) {
+    lt = left;
+    gt = right;
+    int i = left;
+    while (i <= gt) {
+      if (data[i] < pivot) {
+        std::swap(data[lt], data[i]);
+        lt += 1;
         i += 1;
+      } else if (pivot < data[i]) {
+        std::swap(data[i], data[gt]);
+        gt -= 1;
       } else {
-        B[k] = A[j];
-        j += 1;
+        i += 1;
       }
     }
   }
 
-  int linearSearch(T e) const {
-    for (int i = 0; i < m_length; i++) {
-      int index = internal_index(i);
-      if (m_data[index] == e) {
-        return i;
+  static void insertion_sort(T *data, int left, int right) {
+    for (int i = left + 1; i <= right; i++) {
+      T value = std::move(data[i]);
+      int j = i;
+      for (; j > left && value < data[j - 1]; j--) {
+        data[j] = std::move(data[j - 1]);
       }
+      data[j] = std::move(value);
     }
-    return -1;
   }
 
-  int binSearch(T e) const {
-    int left = 0;
-    int right = m_length - 1;
+  // A xorshift generator per thread, so selection needs no shared state.
+  static int random_index(int left, int right) {
+    static thread_local uint64_t state = 0x9E3779B97F4A7C15ull;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    uint64_t range = right - left + 1;
+    return left + (int)(((state >> 32) * range) >> 32);
+  }
+
+  // Runs f(0) .. f(threads - 1) concurrently, one on the calling thread.
+  template <typename Function>
+  static void parallel_for(int threads, Function f) {
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++) {
+      workers.push_back(std::thread(f, t));
+    }
+    f(0);
+    for (size_t t = 0; t < workers.size(); t++) {
+      workers[t].join();
+    }
+  }
+
+  int scan_threads(int threads) const {
+    if (threads <= 0) {
+      threads = std::thread::hardware_concurrency();
+    }
+    threads = std::min(threads, m_length / scan_share);
+    return threads < 1 ? 1 : threads;
+  }
+
+  // The first index of worker t's share.
+  int share(int t, int threads) const {
+    return (long long)m_length * t / threads;
+  }
+
+  // Calls f(data, first, count) for the part of [first, last) in each
+  // segment, where data points at element first of that part.
+  template <typename U, typename Function>
+  static void for_each_span(Segments<U> view, int first, int last,
+                            Function f) {
+    int split = view.first.length;
+    if (first < split) {
+      int end = last < split ? last : split;
+      f(view.first.data + first, first, end - first);
+    }
+    if (last > split) {
+      int begin = first > split ? first : split;
+      f(view.second.data + (begin - split), begin, last - begin);
+    }
+  }
+
+  // Scans each worker's share in blocks with find(Span), which returns the
+  // index of a match in the span or -1, and keeps the lowest match.
+  template <typename Finder> int find_first(int threads, Finder find) const {
+    std::atomic<int> found(m_length);
+    Segments<const T> view = segments();
+
+    parallel_for(threads, [&](int t) {
+      int last = share(t + 1, threads);
+      for (int block = share(t, threads); block < last;
+           block += find_block) {
+        if (found.load(std::memory_order_relaxed) < block) {
+          return;
+        }
+
+        int match = -1;
+        int end = last - block < find_block ? last : block + find_block;
+        for_each_span(view, block, end,
+                      [&](const T *data, int first, int count) {
+                        if (match == -1) {
+                          Span<const T> span = {data, count};
+                          int i = find(span);
+                          match = i == -1 ? -1 : first + i;
+                        }
+                      });
+
+        if (match != -1) {
+          int current = found.load(std::memory_order_relaxed);
+          while (match < current &&
+                 !found.compare_exchange_weak(current, match,
+                                              std::memory_order_relaxed)) {
+          }
+          return;
+        }
+      }
+    });
+
+    int i = found.load(std::memory_order_relaxed);
+    return i == m_length ? -1 : i;
+  }
+
+  // Returns how many elements of the first run of the pair that contains
+  // output position d come before d in the merged pair.
+  static int merge_split(const T *from, const std::vector<int> &runs, int d) {
+    int count = runs.size() - 1;
+    for (int r = 0; r < count; r += 2) {
+      int lo = runs[r];
+      int middle = runs[r + 1];
+      int hi = r + 2 <= count ? runs[r + 2] : middle;
+      if (d < hi) {
+        return merge_path(from + lo, middle - lo, from + middle, hi - middle,
+                          d - lo);
+      }
+    }
+    return 0;
+  }
+
+  // Writes output positions [first, last) of one merge round, where runs
+  // 2k and 2k + 1 of from are merged into the same range of to. A trailing
+  // unpaired run is moved across unchanged. The splits are merge_split(first)
+  // and merge_split(last), so that a worker never reads an element that a
+  // neighbouring worker may be moving.
+  static void merge_round(T *from, T *to, const std::vector<int> &runs,
+                          int first, int last, int first_split,
+                          int last_split) {
+    int count = runs.size() - 1;
+    for (int r = 0; r < count; r += 2) {
+      int lo = runs[r];
+      int middle = runs[r + 1];
+      int hi = r + 2 <= count ? runs[r + 2] : middle;
+
+      int begin = std::max(first, lo);
+      int end = std::min(last, hi);
+      if (begin >= end) {
+        continue;
+      }
+
+      T *a = from + lo;
+      T *b = from + middle;
+      int a_length = middle - lo;
+      int i = begin == first ? first_split : 0;
+      int j = begin - lo - i;
+      int i_end = end == last && last < hi ? last_split : a_length;
+      int j_end = end - lo - i_end;
+
+      for (T *out = to + begin; out != to + end; ++out) {
+        if (i < i_end && (j >= j_end || !(b[j] < a[i]))) {
+          *out = std::move(a[i]);
+          i += 1;
+        } else {
+          *out = std::move(b[j]);
+          j += 1;
+        }
+      }
+    }
+  }
 
-    while (left <= right) {
-      int m = (left + right) / 2;
-      int index = internal_index(m);
-      if (m_data[index] < e) {
-        left = m + 1;
-      } else if (m_data[index] > e) {
-        right = m - 1;
+  // Returns how many elements of a are among the first d outputs of a stable
+  // merge of a and b, so a merge can be started at any output position.
+  static int merge_path(const T *a, int a_length, const T *b, int b_length,
+                        int d) {
+    int lo = std::max(0, d - b_length);
+    int hi = std::min(d, a_length);
+    while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (b[d - mid - 1] < a[mid]) {
+        hi = mid;
       } else {
-        return m;
+        lo = mid + 1;
+      }
+    }
+    return lo;
+  }
+
+  // Moves the live elements so that they no longer wrap around the buffer.
+  void linearize() {
+    if (m_start + m_length > m_capacity) {
+      resize(m_capacity);
+    }
+  }
+
+  template <typename Predicate>
+  static int find_if(Span<const T> span, Predicate &pred) {
+    const int block = 32;
+
+    int i = 0;
+    for (; i + block <= span.length; i += block) {
+      bool found = false;
+      for (int j = 0; j < block; j++) {
+        found |= static_cast<bool>(pred(span.data[i + j]));
+      }
+      if (found) {
+        break;
+      }
+    }
+
+    for (; i < span.length; i++) {
+      if (pred(span.data[i])) {
+        return i;
       }
     }
     return -1;
   }
 
-private:
-  int internal_index(int i) const { return (m_start + i) % m_capacity; }
+  // An empty array with room for capacity elements. Constructors that fill
+  // the buffer delegate here, so the destructor cleans up if filling throws.
+  struct Reserved {};
+  CircularDynamicArray(Reserved, int capacity, const Allocator &allocator)
+      : m_capacity(capacity), m_length(0), m_start(0),
+        m_allocator(allocator) {
+    m_data = allocate(m_capacity);
+  }
 
-  T &index(int i) { return m_data[internal_index(i)]; }
+  template <typename Iterator>
+  static int range_capacity(Iterator, Iterator, std::input_iterator_tag) {
+    return 2;
+  }
 
-  void resize(int size) {
-    T *old = m_data;
-    m_data = new T[size];
+  template <typename Iterator>
+  static int range_capacity(Iterator first, Iterator last,
+                            std::forward_iterator_tag) {
+    return round_capacity(std::distance(first, last));
+  }
+
+  // Storage is allocated uninitialized; only the live range [m_start,
+  // m_start + m_length) holds constructed elements.
+  T *allocate(int size) { return AllocatorTraits::allocate(m_allocator, size); }
+
+  void deallocate(T *data, int size) {
+    if (data != nullptr) {
+      AllocatorTraits::deallocate(m_allocator, data, size);
+    }
+  }
+
+  void destroy_all() {
     for (int i = 0; i < m_length; i++) {
-      m_data[i] = old[(m_start + i) % m_capacity];
+      m_data[internal_index(i)].~T();
+    }
+  }
+
+  template <typename... Args> T &construct_end(Args &&...args) {
+    T *slot = &m_data[internal_index(m_length)];
+    new (slot) T(std::forward<Args>(args)...);
+    m_length += 1;
+    return *slot;
+  }
+
+  template <typename... Args> T &construct_front(Args &&...args) {
+    int index = internal_index(-1);
+    new (&m_data[index]) T(std::forward<Args>(args)...);
+    m_start = index;
+    m_length += 1;
+    return m_data[index];
+  }
+
+  // Copy constructs count values into the contiguous slots starting at index.
+  // If a copy throws, the ones already made are destroyed.
+  void copy_into(int index, const T *values, int count) {
+    if (std::is_trivially_copyable<T>::value) {
+      std::memcpy(static_cast<void *>(&m_data[index]), values,
+                  sizeof(T) * count);
+      return;
+    }
+
+    int i = 0;
+    try {
+      for (; i < count; i++) {
+        new (&m_data[index + i]) T(values[i]);
+      }
+    } catch (...) {
+      while (i > 0) {
+        m_data[index + --i].~T();
+      }
+      throw;
+    }
+  }
+
+  void ensure_capacity(int size) {
+    if (size > m_capacity) {
+      resize(round_capacity(size));
     }
-    delete[] old;
+  }
 
+  void grow() {
+    if (m_capacity == 0) {
+      resize(round_capacity(std::max(m_policy.min_capacity, 2)));
+    } else if (m_capacity == max_capacity) {
+      throw std::length_error("CircularDynamicArray: capacity limit reached");
+    } else if (m_capacity > max_capacity >> m_policy.growth_shift) {
+      resize(max_capacity);
+    } else {
+      resize(m_capacity << m_policy.growth_shift);
+    }
+  }
+
+  void shrink_if_sparse() {
+    if (m_length != 0 && m_policy.shrink_ratio != 0 &&
+        m_capacity / 2 >= m_policy.min_capacity &&
+        m_capacity / 2 >= m_length &&
+        m_capacity / m_policy.shrink_ratio >= m_length) {
+      resize(m_capacity / 2);
+    }
+  }
+
+  // Elements are moved only if that cannot throw, and copied otherwise, so a
+  // throwing copy leaves the array as it was.
+  void resize(int size) {
+    T *data = allocate(size);
+    int i = 0;
+    try {
+      for (; i < m_length; i++) {
+        new (&data[i]) T(std::move_if_noexcept(m_data[internal_index(i)]));
+      }
+    } catch (...) {
+      while (i > 0) {
+        data[--i].~T();
+      }
+      deallocate(data, size);
+      throw;
+    }
+
+    destroy_all();
+    deallocate(m_data, m_capacity);
+    m_data = data;
     m_capacity = size;
     m_start = 0;
   }
 
 private:
+  typedef std::allocator_traits<Allocator> AllocatorTraits;
+
   T *m_data;
   int m_capacity;
   int m_length;
   int m_start;
+  GrowthPolicy m_policy;
+  Allocator m_allocator;
+};
 
-  T dummy;
-};
\ No newline at end of file
+#endif
@@ -0,0 +1,197 @@
+#ifndef INCREMENTAL_CIRCULAR_DYNAMIC_ARRAY_CPP
+#define INCREMENTAL_CIRCULAR_DYNAMIC_ARRAY_CPP
+
+#include <new>
+#include <utility>
+
+// A CircularDynamicArray whose growth is spread over many calls, so that no
+// single addEnd or addFront is O(n).
+//
+// When the ring fills, a buffer of twice the capacity is allocated but nothing
+// is moved. The old buffer stays alongside it, holding a contiguous range of
+// indices [m_old_first, m_old_last), and every later call moves up to
+// migration_step elements from the old buffer into the new one, freeing the
+// old buffer once it is empty. New elements always go into the new buffer.
+// The old range holds at most half the new capacity and each add migrates at
+// least one element, so migration always finishes before the new buffer
+// fills.
+//
+// Both buffers use the same start. An element's slot in either one is its
+// position start + i masked to that buffer's capacity, so migrating an element
+// never disturbs another and operator[] only has to know which buffer an index
+// is in. The buffer never shrinks.
+template <typename T> class IncrementalCircularDynamicArray {
+public:
+  explicit IncrementalCircularDynamicArray(int migration_step = 16)
+      : m_capacity(2), m_length(0), m_start(0), m_old(nullptr),
+        m_old_capacity(0), m_old_first(0), m_old_last(0),
+        m_migration_step(migration_step < 1 ? 1 : migration_step) {
+    m_data = allocate(m_capacity);
+  }
+
+  IncrementalCircularDynamicArray(const IncrementalCircularDynamicArray &) =
+      delete;
+  IncrementalCircularDynamicArray &
+  operator=(const IncrementalCircularDynamicArray &) = delete;
+
+  ~IncrementalCircularDynamicArray() {
+    destroy_all();
+    ::operator delete(m_old);
+    ::operator delete(m_data);
+  }
+
+  T &operator[](int i) { return slot(i); }
+  const T &operator[](int i) const {
+    return const_cast<IncrementalCircularDynamicArray *>(this)->slot(i);
+  }
+
+  void addEnd(const T &v) { emplaceEnd(v); }
+  void addEnd(T &&v) { emplaceEnd(std::move(v)); }
+
+  void addFront(const T &v) { emplaceFront(v); }
+  void addFront(T &&v) { emplaceFront(std::move(v)); }
+
+  template <typename... Args> void emplaceEnd(Args &&...args) {
+    if (m_length == m_capacity) {
+      grow();
+    }
+
+    new (&m_data[position(m_length)]) T(std::forward<Args>(args)...);
+    m_length += 1;
+    migrate();
+  }
+
+  template <typename... Args> void emplaceFront(Args &&...args) {
+    if (m_length == m_capacity) {
+      grow();
+    }
+
+    int start = position(-1);
+    new (&m_data[start]) T(std::forward<Args>(args)...);
+    m_start = start;
+    m_length += 1;
+    if (migrating()) {
+      m_old_first += 1;
+      m_old_last += 1;
+    }
+    migrate();
+  }
+
+  void delEnd() {
+    slot(m_length - 1).~T();
+    if (migrating() && m_old_last == m_length) {
+      m_old_last -= 1;
+    }
+    m_length -= 1;
+    migrate();
+  }
+
+  void delFront() {
+    slot(0).~T();
+    if (migrating()) {
+      if (m_old_first > 0) {
+        m_old_first -= 1;
+      }
+      m_old_last -= 1;
+    }
+    m_start = position(1);
+    m_length -= 1;
+    migrate();
+  }
+
+  void clear() {
+    destroy_all();
+    release_old();
+    m_length = 0;
+    m_start = 0;
+  }
+
+  int length() const { return m_length; }
+  int capacity() const { return m_capacity; }
+
+  // Whether elements are still waiting to move out of the old buffer.
+  bool migrating() const { return m_old != nullptr; }
+
+private:
+  static T *allocate(int size) {
+    return static_cast<T *>(::operator new(sizeof(T) * size));
+  }
+
+  int position(int i) const { return (m_start + i) & (m_capacity - 1); }
+
+  bool in_old(int i) const {
+    return migrating() && i >= m_old_first && i < m_old_last;
+  }
+
+  T &slot(int i) {
+    int p = position(i);
+    return in_old(i) ? m_old[p & (m_old_capacity - 1)] : m_data[p];
+  }
+
+  void grow() {
+    // Only reachable with nothing left to migrate, but finishing here keeps
+    // the two-buffer invariant obvious.
+    while (migrating()) {
+      migrate();
+    }
+
+    m_old = m_data;
+    m_old_capacity = m_capacity;
+    m_old_first = 0;
+    m_old_last = m_length;
+
+    m_capacity *= 2;
+    m_data = allocate(m_capacity);
+  }
+
+  // Moves up to m_migration_step elements from the front of the old range.
+  void migrate() {
+    if (!migrating()) {
+      return;
+    }
+
+    int last = m_old_first + m_migration_step;
+    if (last > m_old_last) {
+      last = m_old_last;
+    }
+    for (; m_old_first < last; m_old_first++) {
+      int p = position(m_old_first);
+      T &from = m_old[p & (m_old_capacity - 1)];
+      new (&m_data[p]) T(std::move(from));
+      from.~T();
+    }
+
+    if (m_old_first == m_old_last) {
+      release_old();
+    }
+  }
+
+  void release_old() {
+    ::operator delete(m_old);
+    m_old = nullptr;
+    m_old_capacity = 0;
+    m_old_first = 0;
+    m_old_last = 0;
+  }
+
+  void destroy_all() {
+    for (int i = 0; i < m_length; i++) {
+      slot(i).~T();
+    }
+  }
+
+  T *m_data;
+  int m_capacity;
+  int m_length;
+  int m_start;
+
+  // The buffer being migrated from, or nullptr, and the indices still in it.
+  T *m_old;
+  int m_old_capacity;
+  int m_old_first;
+  int m_old_last;
+
+  int m_migration_step;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef MAPPED_CIRCULAR_DYNAMIC_ARRAY_CPP
+#define MAPPED_CIRCULAR_DYNAMIC_ARRAY_CPP
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+#include "RingCapacity.cpp"
+
+// A CircularDynamicArray whose ring lives in a memory-mapped file, so its
+// contents survive restarts and its pages are managed by the page cache.
+//
+// The file starts with a small header holding the ring's start, length and
+// capacity, followed by the buffer itself. Every change updates the header in
+// place, so reopening the file only maps it: no element is read or copied.
+// Growth extends the file and remaps it instead of allocating a new buffer,
+// then copies the part that wrapped past the old end into the new space. The
+// buffer never shrinks.
+//
+// addEnd, delEnd and growth each commit with a single header store, so a
+// process killed at any point reopens with the ring as it was before or
+// after the call. addFront and delFront have to store both start and length;
+// they do so in the order that leaves no stale slot inside the ring, but a
+// process killed between the two stores reopens with the last element lost.
+//
+// Only trivially copyable T can be stored, and a file must be reopened with
+// the same T. Positions are ints, so the capacity is at most max_capacity
+// elements.
+template <typename T> class MappedCircularDynamicArray {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "MappedCircularDynamicArray needs a trivially copyable T");
+
+public:
+  // Opens path, creating it with room for capacity elements if it does not
+  // exist. Throws std::runtime_error if the file cannot be opened or mapped,
+  // was written for a different element size, or does not hold a whole ring.
+  MappedCircularDynamicArray(const char *path, int capacity = 1024) {
+    if (capacity > max_capacity) {
+      throw std::length_error("MappedCircularDynamicArray: capacity too large");
+    }
+
+    m_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (m_fd < 0) {
+      fail("open", path);
+    }
+
+    struct stat info;
+    if (fstat(m_fd, &info) < 0) {
+      fail("fstat", path);
+    }
+
+    if (info.st_size == 0) {
+      int size = ring_capacity("MappedCircularDynamicArray", capacity);
+      m_size = data_offset + sizeof(T) * size;
+      if (ftruncate(m_fd, m_size) < 0) {
+        fail("ftruncate", path);
+      }
+      map(path);
+
+      m_header->magic = magic;
+      m_header->element_size = sizeof(T);
+      m_header->start = 0;
+      m_header->length = 0;
+      m_header->capacity = size;
+    } else {
+      m_size = info.st_size;
+      if (m_size < data_offset) {
+        close(m_fd);
+        throw std::runtime_error(std::string(path) + ": not a ring");
+      }
+      map(path);
+
+      if (m_header->magic != magic || m_header->element_size != sizeof(T)) {
+        munmap(m_map, m_size);
+        close(m_fd);
+        throw std::runtime_error(std::string(path) +
+                                 ": not a ring of this element type");
+      }
+      if (!valid_header()) {
+        munmap(m_map, m_size);
+        close(m_fd);
+        throw std::runtime_error(std::string(path) + ": corrupt ring header");
+      }
+    }
+  }
+
+  MappedCircularDynamicArray(const MappedCircularDynamicArray &) = delete;
+  MappedCircularDynamicArray &
+  operator=(const MappedCircularDynamicArray &) = delete;
+
+  ~MappedCircularDynamicArray() {
+    munmap(m_map, m_size);
+    close(m_fd);
+  }
+
+  T &operator[](int i) { return m_data[internal_index(i)]; }
+
+  void addEnd(const T &v) {
+    if (m_header->length == m_header->capacity) {
+      grow();
+    }
+
+    m_data[internal_index(m_header->length)] = v;
+    m_header->length += 1;
+  }
+
+  void addFront(const T &v) {
+    if (m_header->length == m_header->capacity) {
+      grow();
+    }
+
+    int index = internal_index(-1);
+    m_data[index] = v;
+    m_header->start = index;
+    m_header->length += 1;
+  }
+
+  void delEnd() { m_header->length -= 1; }
+
+  void delFront() {
+    int start = internal_index(1);
+    m_header->length -= 1;
+    m_header->start = start;
+  }
+
+  void clear() {
+    m_header->length = 0;
+    m_header->start = 0;
+  }
+
+  int length() const { return m_header->length; }
+  int capacity() const { return m_header->capacity; }
+
+  // Blocks until the file on disk matches the mapping.
+  void sync() { msync(m_map, m_size, MS_SYNC); }
+
+private:
+  struct Header {
+    uint64_t magic;
+    uint64_t element_size;
+    int64_t start;
+    int64_t length;
+    int64_t capacity;
+  };
+
+  static const uint64_t magic = 0x31474e4952414443ull;
+
+  // The buffer starts a cache line into the file.
+  static const size_t data_offset = 64;
+
+  static const int64_t max_capacity = int64_t(1) << 30;
+
+  // Whether the header describes a ring that fits in the mapped file.
+  bool valid_header() const {
+    int64_t capacity = m_header->capacity;
+    if (capacity <= 0 || capacity > max_capacity ||
+        (capacity & (capacity - 1)) != 0) {
+      return false;
+    }
+    if (m_header->length < 0 || m_header->length > capacity ||
+        m_header->start < 0 || m_header->start >= capacity) {
+      return false;
+    }
+    return m_size >= data_offset + sizeof(T) * capacity;
+  }
+
+  int internal_index(int i) const {
+    return (m_header->start + i) & (m_header->capacity - 1);
+  }
+
+  void map(const char *path) {
+    void *p =
+        mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (p == MAP_FAILED) {
+      fail("mmap", path);
+    }
+    set_map(p);
+  }
+
+  void set_map(void *p) {
+    m_map = p;
+    m_header = static_cast<Header *>(p);
+    m_data = reinterpret_cast<T *>(static_cast<char *>(p) + data_offset);
+  }
+
+  void grow() {
+    int64_t capacity = m_header->capacity;
+    if (capacity >= max_capacity) {
+      throw std::length_error("MappedCircularDynamicArray: capacity too large");
+    }
+    size_t size = data_offset + sizeof(T) * capacity * 2;
+    if (ftruncate(m_fd, size) < 0) {
+      throw std::runtime_error(std::string("ftruncate: ") +
+                               std::strerror(errno));
+    }
+    void *p = mremap(m_map, m_size, size, MREMAP_MAYMOVE);
+    if (p == MAP_FAILED) {
+      throw std::runtime_error(std::string("mremap: ") + std::strerror(errno));
+    }
+    m_size = size;
+    set_map(p);
+
+    // The ring is full, so it either fits in [start, capacity) already or
+    // wraps. The wrapped prefix is copied to just past the old end, which is
+    // where the doubled capacity puts it, and start never changes; until the
+    // capacity store below the header still describes the old ring, whose
+    // elements are untouched.
+    int64_t wrapped = m_header->start + m_header->length - capacity;
+    if (wrapped > 0) {
+      std::memcpy(m_data + capacity, m_data, sizeof(T) * wrapped);
+    }
+    m_header->capacity = capacity * 2;
+  }
+
+  // Only for the constructor, which must not leak the file on failure.
+  void fail(const char *call, const char *path) {
+    std::string message = std::string(path) + ": " + call + ": " +
+                          std::strerror(errno);
+    if (m_fd >= 0) {
+      close(m_fd);
+    }
+    throw std::runtime_error(message);
+  }
+
+  int m_fd;
+  size_t m_size;
+  void *m_map;
+
+  Header *m_header;
+  T *m_data;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef RADIX_SORT_CPP
+#define RADIX_SORT_CPP
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// LSD radix sort for arithmetic element types, one byte per pass. Each value
+// is first mapped to an unsigned key that orders the same way: signed
+// integers have their sign bit flipped, and floating point values have every
+// bit flipped when negative and only the sign bit flipped otherwise. Under
+// that order -0.0 sorts before +0.0 and NaNs sort to the ends by sign.
+//
+// RadixSort<T>::enabled is false for any other T.
+template <typename T, typename Enable = void> struct RadixKey {
+  static const bool enabled = false;
+};
+
+template <typename T>
+struct RadixKey<T,
+                typename std::enable_if<std::is_integral<T>::value &&
+                                        !std::is_same<T, bool>::value>::type> {
+  static const bool enabled = true;
+  typedef typename std::make_unsigned<T>::type Key;
+
+  static Key key(T value) {
+    Key key = static_cast<Key>(value);
+    if (std::is_signed<T>::value) {
+      key ^= Key(1) << (sizeof(Key) * 8 - 1);
+    }
+    return key;
+  }
+};
+
+template <typename T, typename Bits> struct FloatRadixKey {
+  static const bool enabled = true;
+  typedef Bits Key;
+
+  static Key key(T value) {
+    Key bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    Key sign = Key(1) << (sizeof(Key) * 8 - 1);
+    return (bits & sign) ? ~bits : bits ^ sign;
+  }
+};
+
+template <> struct RadixKey<float> : FloatRadixKey<float, uint32_t> {};
+template <> struct RadixKey<double> : FloatRadixKey<double, uint64_t> {};
+
+template <typename T> struct RadixSort {
+  static const bool enabled = RadixKey<T>::enabled;
+
+  static void sort(T *data, int n) {
+    if (n <= 1) {
+      return;
+    }
+
+    typedef typename RadixKey<T>::Key Key;
+    const int passes = sizeof(Key);
+
+    // Every pass's histogram is taken in a single read of the input.
+    std::vector<int> counts(passes * 256, 0);
+    for (int i = 0; i < n; i++) {
+      Key key = RadixKey<T>::key(data[i]);
+      for (int pass = 0; pass < passes; pass++) {
+        counts[pass * 256 + ((key >> (pass * 8)) & 0xFF)] += 1;
+      }
+    }
+
+    std::vector<T> scratch(n);
+    T *from = data;
+    T *to = scratch.data();
+    for (int pass = 0; pass < passes; pass++) {
+      int *count = &counts[pass * 256];
+
+      // A byte that is the same in every key would only copy the array.
+      if (count[(RadixKey<T>::key(from[0]) >> (pass * 8)) & 0xFF] == n) {
+        continue;
+      }
+
+      int offset = 0;
+      for (int digit = 0; digit < 256; digit++) {
+        int size = count[digit];
+        count[digit] = offset;
+        offset += size;
+      }
+
+      for (int i = 0; i < n; i++) {
+        int digit = (RadixKey<T>::key(from[i]) >> (pass * 8)) & 0xFF;
+        to[count[digit]++] = from[i];
+      }
+      std::swap(from, to);
+    }
+
+    if (from != data) {
+      std::memcpy(data, from, sizeof(T) * n);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef RING_CAPACITY_CPP
+#define RING_CAPACITY_CPP
+
+#include <stdexcept>
+#include <string>
+
+// The rings in this directory wrap positions with a mask, so their capacities
+// are powers of two. max_ring_capacity is the largest one an int holds.
+const int max_ring_capacity = 1 << 30;
+
+// The smallest power of two that is at least size, and at least 1. Throws
+// std::length_error, naming owner, if size is over max_ring_capacity.
+inline int ring_capacity(const char *owner, int size) {
+  if (size > max_ring_capacity) {
+    throw std::length_error(std::string(owner) + ": size " +
+                            std::to_string(size) + " exceeds capacity limit");
+  }
+  int capacity = 1;
+  while (capacity < size) {
+    capacity <<= 1;
+  }
+  return capacity;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SAMPLE_WINDOW_CPP
+#define SAMPLE_WINDOW_CPP
+
+#include <cstdint>
+
+#include "CircularDynamicArray.cpp"
+
+// The samples of a FIFO window in arrival order, for windows that keep an
+// index over them. Samples are pushed at the back and expired ones popped
+// from the front, as with addEnd and delFront on a CircularDynamicArray.
+//
+// Every sample is also numbered by its position among all samples ever
+// pushed. Positions never change while a sample is in the window, so an index
+// can refer to samples by position and look them up in constant time.
+template <typename T> class SampleWindow {
+public:
+  // With a max_length the window is full at that many samples, and its owner
+  // is expected to pop the oldest before pushing. 0 means it is never full.
+  explicit SampleWindow(int max_length = 0)
+      : m_max_length(max_length), m_first(0) {}
+
+  bool full() const {
+    return m_max_length > 0 && m_values.length() == m_max_length;
+  }
+
+  // Returns the position v was pushed at.
+  int64_t push(const T &v) {
+    int64_t position = m_first + m_values.length();
+    m_values.addEnd(v);
+    return position;
+  }
+
+  // Removes the oldest sample. The window must not be empty.
+  void pop() {
+    m_values.delFront();
+    m_first += 1;
+  }
+
+  void clear() {
+    m_values.clear();
+    m_first = 0;
+  }
+
+  int length() const { return m_values.length(); }
+
+  // Samples by age, 0 being the oldest.
+  const T &operator[](int i) const { return m_values[i]; }
+  const T &front() const { return m_values[0]; }
+  const T &back() const { return m_values[m_values.length() - 1]; }
+
+  // The position of the oldest sample, and the sample at a position that is
+  // still in the window.
+  int64_t first() const { return m_first; }
+  const T &sample(int64_t position) const {
+    return m_values[position - m_first];
+  }
+
+private:
+  CircularDynamicArray<T> m_values;
+  int m_max_length;
+  int64_t m_first;
+};
+
+#endif
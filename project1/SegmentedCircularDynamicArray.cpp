@@ -0,0 +1,338 @@
+#ifndef SEGMENTED_CIRCULAR_DYNAMIC_ARRAY_CPP
+#define SEGMENTED_CIRCULAR_DYNAMIC_ARRAY_CPP
+
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "CircularDynamicArray.cpp"
+
+// A CircularDynamicArray stored as a ring of fixed-size chunks instead of one
+// buffer. The chunk map is itself a CircularDynamicArray of chunk pointers:
+// adding at either end allocates at most one chunk and deleting frees at most
+// one, elements never move once constructed, and growth never needs the old
+// and new buffers side by side. Only the map is ever resized, and it holds
+// one pointer per ChunkSize elements.
+//
+// Element i is in chunk (offset + i) / ChunkSize at (offset + i) % ChunkSize,
+// where offset is element 0's slot in the first chunk. ChunkSize is a power of
+// two, so operator[] is a shift, a mask and two loads.
+//
+// Only part of CircularDynamicArray's interface is offered: element access
+// through operator[] and at, addEnd, addFront, their emplace forms, delEnd,
+// delFront, clear, length, capacity, iterators, linearSearch, binSearch, Sort
+// and swap. Code templated on the array type can use either class as long as
+// it sticks to these. There is no reserve, growth policy, allocator, QSelect,
+// parallel scanning or snapshotting.
+template <typename T, int ChunkSize = 1024>
+class SegmentedCircularDynamicArray {
+  static_assert(ChunkSize > 0 && (ChunkSize & (ChunkSize - 1)) == 0,
+                "ChunkSize must be a power of two");
+
+public:
+  template <typename U> class Iterator {
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef typename std::remove_const<U>::type value_type;
+    typedef int difference_type;
+    typedef U *pointer;
+    typedef U &reference;
+
+    typedef typename std::conditional<std::is_const<U>::value,
+                                      const SegmentedCircularDynamicArray,
+                                      SegmentedCircularDynamicArray>::type
+        Array;
+
+    Iterator() : m_array(nullptr), m_position(0) {}
+    Iterator(Array *array, int position)
+        : m_array(array), m_position(position) {}
+
+    // Allows an iterator to convert to a const_iterator.
+    operator Iterator<const U>() const {
+      return Iterator<const U>(m_array, m_position);
+    }
+
+    U &operator*() const { return (*m_array)[m_position]; }
+    U *operator->() const { return &**this; }
+    U &operator[](int n) const { return (*m_array)[m_position + n]; }
+
+    Iterator &operator++() {
+      m_position += 1;
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator old = *this;
+      m_position += 1;
+      return old;
+    }
+    Iterator &operator--() {
+      m_position -= 1;
+      return *this;
+    }
+    Iterator operator--(int) {
+      Iterator old = *this;
+      m_position -= 1;
+      return old;
+    }
+
+    Iterator &operator+=(int n) {
+      m_position += n;
+      return *this;
+    }
+    Iterator &operator-=(int n) {
+      m_position -= n;
+      return *this;
+    }
+    Iterator operator+(int n) const { return Iterator(*this) += n; }
+    Iterator operator-(int n) const { return Iterator(*this) -= n; }
+    friend Iterator operator+(int n, const Iterator &it) { return it + n; }
+    friend int operator-(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position - rhs.m_position;
+    }
+
+    friend bool operator==(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position == rhs.m_position;
+    }
+    friend bool operator!=(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position != rhs.m_position;
+    }
+    friend bool operator<(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position < rhs.m_position;
+    }
+    friend bool operator>(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position > rhs.m_position;
+    }
+    friend bool operator<=(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position <= rhs.m_position;
+    }
+    friend bool operator>=(const Iterator &lhs, const Iterator &rhs) {
+      return lhs.m_position >= rhs.m_position;
+    }
+
+  private:
+    Array *m_array;
+    int m_position;
+  };
+
+  typedef Iterator<T> iterator;
+  typedef Iterator<const T> const_iterator;
+
+  SegmentedCircularDynamicArray()
+      : m_offset(0), m_length(0), m_spare(nullptr) {}
+
+  explicit SegmentedCircularDynamicArray(int size)
+      : SegmentedCircularDynamicArray() {
+    for (int i = 0; i < size; i++) {
+      emplaceEnd();
+    }
+  }
+
+  SegmentedCircularDynamicArray(const SegmentedCircularDynamicArray &old)
+      : SegmentedCircularDynamicArray() {
+    for (int i = 0; i < old.m_length; i++) {
+      addEnd(old[i]);
+    }
+  }
+
+  // Leaves old empty but usable.
+  SegmentedCircularDynamicArray(SegmentedCircularDynamicArray &&old) noexcept
+      : SegmentedCircularDynamicArray() {
+    swap(old);
+  }
+
+  SegmentedCircularDynamicArray &
+  operator=(const SegmentedCircularDynamicArray &rhs) {
+    if (this != &rhs) {
+      SegmentedCircularDynamicArray copy(rhs);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  SegmentedCircularDynamicArray &
+  operator=(SegmentedCircularDynamicArray &&rhs) noexcept {
+    swap(rhs);
+    return *this;
+  }
+
+  ~SegmentedCircularDynamicArray() {
+    clear();
+    ::operator delete(m_spare);
+  }
+
+  T &operator[](int i) {
+    CDA_ASSERT(i >= 0 && i < m_length);
+    int slot = m_offset + i;
+    return m_chunks[slot / ChunkSize][slot & (ChunkSize - 1)];
+  }
+  const T &operator[](int i) const {
+    CDA_ASSERT(i >= 0 && i < m_length);
+    int slot = m_offset + i;
+    return m_chunks[slot / ChunkSize][slot & (ChunkSize - 1)];
+  }
+
+  // Throws std::out_of_range if i is not in [0, length()).
+  T &at(int i) {
+    check_index(i);
+    return (*this)[i];
+  }
+  const T &at(int i) const {
+    check_index(i);
+    return (*this)[i];
+  }
+
+  void addEnd(const T &v) { emplaceEnd(v); }
+  void addEnd(T &&v) { emplaceEnd(std::move(v)); }
+
+  void addFront(const T &v) { emplaceFront(v); }
+  void addFront(T &&v) { emplaceFront(std::move(v)); }
+
+  template <typename... Args> T &emplaceEnd(Args &&...args) {
+    int slot = m_offset + m_length;
+    if (slot / ChunkSize == m_chunks.length()) {
+      m_chunks.addEnd(allocate_chunk());
+    }
+
+    T *element = &m_chunks[slot / ChunkSize][slot & (ChunkSize - 1)];
+    new (element) T(std::forward<Args>(args)...);
+    m_length += 1;
+    return *element;
+  }
+
+  template <typename... Args> T &emplaceFront(Args &&...args) {
+    if (m_offset == 0) {
+      m_chunks.addFront(allocate_chunk());
+      m_offset = ChunkSize;
+    }
+
+    T *element = &m_chunks[0][m_offset - 1];
+    new (element) T(std::forward<Args>(args)...);
+    m_offset -= 1;
+    m_length += 1;
+    return *element;
+  }
+
+  void delEnd() {
+    CDA_ASSERT(m_length > 0);
+    (*this)[m_length - 1].~T();
+    m_length -= 1;
+
+    // Free the last chunk once nothing is in it.
+    int chunks = (m_offset + m_length + ChunkSize - 1) / ChunkSize;
+    if (chunks < m_chunks.length()) {
+      free_chunk(m_chunks[m_chunks.length() - 1]);
+      m_chunks.delEnd();
+    }
+  }
+
+  void delFront() {
+    CDA_ASSERT(m_length > 0);
+    (*this)[0].~T();
+    m_offset += 1;
+    m_length -= 1;
+
+    if (m_offset == ChunkSize) {
+      free_chunk(m_chunks[0]);
+      m_chunks.delFront();
+      m_offset = 0;
+    }
+  }
+
+  void clear() {
+    for (int i = 0; i < m_length; i++) {
+      (*this)[i].~T();
+    }
+    while (m_chunks.length() > 0) {
+      free_chunk(m_chunks[m_chunks.length() - 1]);
+      m_chunks.delEnd();
+    }
+    m_offset = 0;
+    m_length = 0;
+  }
+
+  int length() const { return m_length; }
+  int capacity() const { return m_chunks.length() * ChunkSize; }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, m_length); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, m_length); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  // Each chunk is contiguous, so the scan runs chunk by chunk with the same
+  // kernels CircularDynamicArray uses.
+  int linearSearch(const T &e) const {
+    for (int first = 0; first < m_length;) {
+      int slot = m_offset + first;
+      int count = std::min(m_length - first,
+                           ChunkSize - (slot & (ChunkSize - 1)));
+      const T *chunk = &(*this)[first];
+      int i = VectorScan<T>::find(chunk, count, e);
+      if (i != -1) {
+        return first + i;
+      }
+      first += count;
+    }
+    return -1;
+  }
+
+  // Requires the array to be sorted.
+  int binSearch(const T &e) const {
+    const_iterator i = std::lower_bound(begin(), end(), e);
+    if (i != end() && !(e < *i)) {
+      return i - begin();
+    }
+    return -1;
+  }
+
+  // Stable. Elements move between chunks as they are sorted, but no chunk is
+  // allocated or freed.
+  void Sort() { std::stable_sort(begin(), end()); }
+
+  void swap(SegmentedCircularDynamicArray &other) {
+    std::swap(m_chunks, other.m_chunks);
+    std::swap(m_offset, other.m_offset);
+    std::swap(m_length, other.m_length);
+    std::swap(m_spare, other.m_spare);
+  }
+
+private:
+  void check_index(int i) const {
+    if (i < 0 || i >= m_length) {
+      throw std::out_of_range("SegmentedCircularDynamicArray: index " +
+                              std::to_string(i) + " out of range for length " +
+                              std::to_string(m_length));
+    }
+  }
+
+  // One freed chunk is kept back, so pushing and popping across a chunk
+  // boundary does not allocate and free on every call.
+  T *allocate_chunk() {
+    if (m_spare != nullptr) {
+      T *chunk = m_spare;
+      m_spare = nullptr;
+      return chunk;
+    }
+    return static_cast<T *>(::operator new(sizeof(T) * ChunkSize));
+  }
+
+  void free_chunk(T *chunk) {
+    if (m_spare == nullptr) {
+      m_spare = chunk;
+    } else {
+      ::operator delete(chunk);
+    }
+  }
+
+  CircularDynamicArray<T *> m_chunks;
+  int m_offset;
+  int m_length;
+  T *m_spare;
+};
+
+#endif
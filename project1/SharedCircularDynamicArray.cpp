@@ -0,0 +1,125 @@
+#ifndef SHARED_CIRCULAR_DYNAMIC_ARRAY_CPP
+#define SHARED_CIRCULAR_DYNAMIC_ARRAY_CPP
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "CircularDynamicArray.cpp"
+
+// A copy-on-write handle to a CircularDynamicArray. Copying a handle only
+// bumps a reference count, so passing one by value or handing the same
+// snapshot to many worker threads is O(1) however long the array is. The
+// first mutation through a handle whose array is shared copies the array and
+// leaves the other handles with the old one.
+//
+// Every non-const member counts as a mutation, including the non-const
+// operator[] and at(), since the reference they return can be written
+// through. Reads that must not copy go through get(), array() or a const
+// handle.
+//
+// Reading through separate handles from separate threads is safe, and so is
+// mutating one's own handle while other threads read theirs: the reference
+// count is dropped with release ordering and checked with acquire ordering,
+// so a handle that finds itself the only owner also sees every read that
+// other handles made before letting go. A single handle must not be copied
+// and mutated concurrently. A reference returned by a mutating accessor is
+// only good until the handle is copied, since the copy then shares what the
+// reference points to.
+template <typename T, typename Allocator = std::allocator<T> >
+class SharedCircularDynamicArray {
+public:
+  typedef CircularDynamicArray<T, Allocator> Array;
+
+  SharedCircularDynamicArray() : m_block(new Block()) {}
+
+  explicit SharedCircularDynamicArray(int size) : m_block(new Block(size)) {}
+
+  // Takes over array's buffer without copying its elements.
+  explicit SharedCircularDynamicArray(Array &&array)
+      : m_block(new Block(std::move(array))) {}
+
+  SharedCircularDynamicArray(const SharedCircularDynamicArray &other)
+      : m_block(other.m_block) {
+    m_block->references.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  SharedCircularDynamicArray &operator=(const SharedCircularDynamicArray &rhs) {
+    rhs.m_block->references.fetch_add(1, std::memory_order_relaxed);
+    release();
+    m_block = rhs.m_block;
+    return *this;
+  }
+
+  ~SharedCircularDynamicArray() { release(); }
+
+  const T &operator[](int i) const { return m_block->array[i]; }
+  T &operator[](int i) { return mutate()[i]; }
+  const T &at(int i) const { return m_block->array.at(i); }
+  T &at(int i) { return mutate().at(i); }
+
+  // Element i for reading, never copying the array.
+  const T &get(int i) const { return m_block->array[i]; }
+
+  void addEnd(const T &v) { mutate().addEnd(v); }
+  void addFront(const T &v) { mutate().addFront(v); }
+  void delEnd() { mutate().delEnd(); }
+  void delFront() { mutate().delFront(); }
+  void Sort() { mutate().Sort(); }
+
+  // Drops this handle's reference rather than copying the array only to
+  // destroy its elements.
+  void clear() {
+    if (shared()) {
+      Array empty(m_block->array.allocator());
+      empty.setGrowthPolicy(m_block->array.growthPolicy());
+      replace(new Block(std::move(empty)));
+    } else {
+      m_block->array.clear();
+    }
+  }
+
+  int length() const { return m_block->array.length(); }
+  int capacity() const { return m_block->array.capacity(); }
+
+  // Whether another handle refers to the same array.
+  bool shared() const {
+    return m_block->references.load(std::memory_order_acquire) > 1;
+  }
+
+  // The array for read-only use, such as searching or scanning.
+  const Array &array() const { return m_block->array; }
+
+  // The array for any use, copied first if it is shared.
+  Array &mutate() {
+    if (shared()) {
+      replace(new Block(m_block->array));
+    }
+    return m_block->array;
+  }
+
+private:
+  struct Block {
+    template <typename... Args>
+    explicit Block(Args &&...args)
+        : references(1), array(std::forward<Args>(args)...) {}
+
+    std::atomic<int> references;
+    Array array;
+  };
+
+  void replace(Block *block) {
+    release();
+    m_block = block;
+  }
+
+  void release() {
+    if (m_block->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete m_block;
+    }
+  }
+
+  Block *m_block;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef SLIDING_QUANTILE_CPP
+#define SLIDING_QUANTILE_CPP
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "SampleWindow.cpp"
+
+// A FIFO window of samples that answers order statistics, such as the median
+// or the 99th percentile, in logarithmic time without reordering anything.
+// Samples are pushed at the back and expired ones popped from the front, as
+// with addEnd and delFront on a CircularDynamicArray.
+//
+// The samples are kept in arrival order in a SampleWindow, and an
+// order-statistic index over them is kept in sync: a treap keyed by value,
+// with ties broken by arrival so that every key is unique, in which each node
+// records the size of its subtree. push inserts into the treap and pop removes
+// the oldest sample's node, both in expected O(log n); select walks down by
+// subtree sizes, also in expected O(log n). The answers are exact.
+template <typename T> class SlidingQuantile {
+public:
+  // max_length bounds the window as it does a SampleWindow's; push evicts
+  // the oldest sample to make room.
+  explicit SlidingQuantile(int max_length = 0)
+      : m_samples(max_length), m_root(none), m_seed(0x9e3779b9) {}
+
+  void push(const T &v) {
+    if (m_samples.full()) {
+      pop();
+    }
+
+    int node = new_node(v, m_samples.push(v));
+
+    int less, greater;
+    split(m_root, m_nodes[node].value, m_nodes[node].position, less, greater);
+    m_root = merge(merge(less, node), greater);
+  }
+
+  // Unlinks the oldest sample's node, then drops the sample. Needs a sample
+  // to drop.
+  void pop() {
+    int less, rest;
+    split(m_root, m_samples.front(), m_samples.first(), less, rest);
+
+    // The oldest sample's key is the smallest in rest.
+    int oldest, greater;
+    split_first(rest, oldest, greater);
+    m_free.push_back(oldest);
+    m_root = merge(less, greater);
+
+    m_samples.pop();
+  }
+
+  void clear() {
+    m_samples.clear();
+    m_nodes.clear();
+    m_free.clear();
+    m_root = none;
+  }
+
+  int length() const { return m_samples.length(); }
+  const T &operator[](int i) const { return m_samples[i]; }
+
+  // The kth smallest sample, counting from 1 as QSelect does. k must be in
+  // [1, length()].
+  const T &select(int k) const {
+    int node = m_root;
+    for (;;) {
+      int left = size(m_nodes[node].left);
+      if (k <= left) {
+        node = m_nodes[node].left;
+      } else if (k == left + 1) {
+        return m_nodes[node].value;
+      } else {
+        k -= left + 1;
+        node = m_nodes[node].right;
+      }
+    }
+  }
+
+  // The nearest-rank q-quantile for q in [0, 1]: the smallest sample that at
+  // least a fraction q of the window is no greater than. The window must not
+  // be empty.
+  const T &quantile(double q) const {
+    int n = m_samples.length();
+    int k = std::ceil(q * n);
+    return select(k < 1 ? 1 : k > n ? n : k);
+  }
+
+  const T &median() const { return quantile(0.5); }
+
+  // How many samples are less than v.
+  int rank(const T &v) const {
+    int count = 0;
+    int node = m_root;
+    while (node != none) {
+      if (m_nodes[node].value < v) {
+        count += size(m_nodes[node].left) + 1;
+        node = m_nodes[node].right;
+      } else {
+        node = m_nodes[node].left;
+      }
+    }
+    return count;
+  }
+
+private:
+  static const int none = -1;
+
+  struct Node {
+    T value;
+    int64_t position;
+    uint32_t priority;
+    int size;
+    int left;
+    int right;
+  };
+
+  int new_node(const T &v, int64_t position) {
+    Node node = {v, position, random(), 1, none, none};
+    if (m_free.empty()) {
+      m_nodes.push_back(node);
+      return m_nodes.size() - 1;
+    }
+
+    int index = m_free.back();
+    m_free.pop_back();
+    m_nodes[index] = node;
+    return index;
+  }
+
+  int size(int node) const { return node == none ? 0 : m_nodes[node].size; }
+
+  void update(int node) {
+    m_nodes[node].size =
+        size(m_nodes[node].left) + size(m_nodes[node].right) + 1;
+  }
+
+  // Whether node's key orders before (value, position).
+  bool before(int node, const T &value, int64_t position) const {
+    const Node &n = m_nodes[node];
+    if (n.value < value) {
+      return true;
+    }
+    return !(value < n.value) && n.position < position;
+  }
+
+  // Splits the treap at node into the keys before (value, position) and the
+  // rest.
+  void split(int node, const T &value, int64_t position, int &less,
+             int &rest) {
+    if (node == none) {
+      less = rest = none;
+    } else if (before(node, value, position)) {
+      split(m_nodes[node].right, value, position, m_nodes[node].right, rest);
+      less = node;
+      update(node);
+    } else {
+      split(m_nodes[node].left, value, position, less, m_nodes[node].left);
+      rest = node;
+      update(node);
+    }
+  }
+
+  // Detaches the node with the smallest key, which must exist.
+  void split_first(int node, int &first, int &rest) {
+    if (m_nodes[node].left == none) {
+      first = node;
+      rest = m_nodes[node].right;
+      m_nodes[node].right = none;
+      update(node);
+    } else {
+      split_first(m_nodes[node].left, first, m_nodes[node].left);
+      rest = node;
+      update(node);
+    }
+  }
+
+  // Joins two treaps where every key in lhs orders before every key in rhs.
+  int merge(int lhs, int rhs) {
+    if (lhs == none) {
+      return rhs;
+    }
+    if (rhs == none) {
+      return lhs;
+    }
+
+    if (m_nodes[lhs].priority > m_nodes[rhs].priority) {
+      m_nodes[lhs].right = merge(m_nodes[lhs].right, rhs);
+      update(lhs);
+      return lhs;
+    }
+    m_nodes[rhs].left = merge(lhs, m_nodes[rhs].left);
+    update(rhs);
+    return rhs;
+  }
+
+  uint32_t random() {
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+  }
+
+  SampleWindow<T> m_samples;
+
+  // The treap's nodes, with freed ones listed for reuse.
+  std::vector<Node> m_nodes;
+  std::vector<int> m_free;
+  int m_root;
+  uint32_t m_seed;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef SLIDING_WINDOW_CPP
+#define SLIDING_WINDOW_CPP
+
+#include <cstdint>
+
+#include "CircularDynamicArray.cpp"
+#include "SampleWindow.cpp"
+
+// A FIFO window of samples that answers min, max, sum and mean in constant
+// time. New samples are pushed at the back and expired ones popped from the
+// front, as with addEnd and delFront on a CircularDynamicArray.
+//
+// Besides the samples themselves, kept in a SampleWindow, the window keeps a
+// running sum and two monotonic deques of sample positions: the minimum deque
+// holds every sample that is smaller than all samples pushed after it, so its
+// front is the minimum of the window, and the maximum deque likewise. A push
+// removes the samples it makes irrelevant from the back of each deque and a
+// pop removes the expired sample from their fronts, so every sample enters
+// and leaves each deque once and updates are amortized constant time.
+//
+// Sum is the type the running sum is kept in, which can be wider than T. A
+// floating point sum is updated by adding and subtracting samples, so it can
+// drift from the exact sum of a long-lived window.
+template <typename T, typename Sum = T> class SlidingWindow {
+public:
+  // With a max_length, pushing onto a full window first pops the oldest
+  // sample. 0 means the window only shrinks through pop.
+  explicit SlidingWindow(int max_length = 0)
+      : m_samples(max_length), m_sum() {}
+
+  void push(const T &v) {
+    if (m_samples.full()) {
+      pop();
+    }
+
+    int64_t position = m_samples.push(v);
+    m_sum += v;
+
+    while (m_min.length() > 0 &&
+           v < m_samples.sample(m_min[m_min.length() - 1])) {
+      m_min.delEnd();
+    }
+    m_min.addEnd(position);
+
+    while (m_max.length() > 0 &&
+           m_samples.sample(m_max[m_max.length() - 1]) < v) {
+      m_max.delEnd();
+    }
+    m_max.addEnd(position);
+  }
+
+  // Removes the oldest sample. The window must not be empty.
+  void pop() {
+    m_sum -= m_samples.front();
+
+    if (m_min[0] == m_samples.first()) {
+      m_min.delFront();
+    }
+    if (m_max[0] == m_samples.first()) {
+      m_max.delFront();
+    }
+    m_samples.pop();
+  }
+
+  void clear() {
+    m_samples.clear();
+    m_min.clear();
+    m_max.clear();
+    m_sum = Sum();
+  }
+
+  int length() const { return m_samples.length(); }
+
+  const T &operator[](int i) const { return m_samples[i]; }
+  const T &front() const { return m_samples.front(); }
+  const T &back() const { return m_samples.back(); }
+
+  // The window must not be empty for any of these. Of equal samples, min and
+  // max return the oldest.
+  const T &min() const { return m_samples.sample(m_min[0]); }
+  const T &max() const { return m_samples.sample(m_max[0]); }
+  const Sum &sum() const { return m_sum; }
+  double mean() const { return double(m_sum) / m_samples.length(); }
+
+private:
+  SampleWindow<T> m_samples;
+
+  // Positions of the samples in each monotonic deque.
+  CircularDynamicArray<int64_t> m_min;
+  CircularDynamicArray<int64_t> m_max;
+  Sum m_sum;
+};
+
+#endif
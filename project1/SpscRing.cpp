@@ -0,0 +1,162 @@
+#ifndef SPSC_RING_CPP
+#define SPSC_RING_CPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "RingCapacity.cpp"
+
+// A fixed-capacity ring for exactly one producer thread and one consumer
+// thread. It indexes its buffer the same way CircularDynamicArray does: the
+// capacity is a power of two and positions wrap with a mask. Instead of a
+// start and a length it keeps two counters that only grow, the producer's
+// tail and the consumer's head, so each side writes only its own counter and
+// no lock is needed.
+//
+// Every call is wait-free: a push onto a full ring or a pop from an empty one
+// fails instead of waiting. The counters sit on separate cache lines, and
+// each side caches the other's counter so it only reads across when the
+// cached value shows too little room or data.
+template <typename T> class SpscRing {
+public:
+  // Throws std::length_error if capacity is over max_ring_capacity.
+  explicit SpscRing(int capacity)
+      : m_head(0), m_cached_tail(0), m_tail(0), m_cached_head(0) {
+    m_capacity = ring_capacity("SpscRing", capacity);
+    m_data = static_cast<T *>(::operator new(sizeof(T) * m_capacity));
+  }
+
+  SpscRing(const SpscRing &) = delete;
+  SpscRing &operator=(const SpscRing &) = delete;
+
+  ~SpscRing() {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    for (size_t i = m_head.load(std::memory_order_relaxed); i != tail; i++) {
+      slot(i).~T();
+    }
+    ::operator delete(m_data);
+  }
+
+  // Producer side.
+
+  bool tryPush(const T &value) { return tryEmplace(value); }
+  bool tryPush(T &&value) { return tryEmplace(std::move(value)); }
+
+  template <typename... Args> bool tryEmplace(Args &&...args) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (space(tail, 1) == 0) {
+      return false;
+    }
+
+    new (&slot(tail)) T(std::forward<Args>(args)...);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Pushes as many of the n values as fit and returns how many that was. The
+  // whole batch becomes visible to the consumer at once.
+  int pushBatch(const T *values, int n) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    int count = std::min<size_t>(n, space(tail, n));
+
+    int index = tail & (m_capacity - 1);
+    int first = std::min(count, m_capacity - index);
+    copy(&m_data[index], values, first);
+    copy(&m_data[0], values + first, count - first);
+
+    m_tail.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+  // Consumer side.
+
+  bool tryPop(T &out) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (available(head, 1) == 0) {
+      return false;
+    }
+
+    T &value = slot(head);
+    out = std::move(value);
+    value.~T();
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Moves up to n values into out and returns how many that was.
+  int popBatch(T *out, int n) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    int count = std::min<size_t>(n, available(head, n));
+
+    for (int i = 0; i < count; i++) {
+      T &value = slot(head + i);
+      out[i] = std::move(value);
+      value.~T();
+    }
+
+    m_head.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  // Only exact when neither side is running.
+  int length() const {
+    return m_tail.load(std::memory_order_acquire) -
+           m_head.load(std::memory_order_acquire);
+  }
+  int capacity() const { return m_capacity; }
+
+private:
+  static const size_t cache_line = 64;
+
+  T &slot(size_t i) { return m_data[i & (m_capacity - 1)]; }
+
+  // Free slots as seen by the producer, rereading the consumer's counter only
+  // if the cached one shows fewer than wanted.
+  size_t space(size_t tail, size_t wanted) {
+    size_t space = m_capacity - (tail - m_cached_head);
+    if (space < wanted) {
+      m_cached_head = m_head.load(std::memory_order_acquire);
+      space = m_capacity - (tail - m_cached_head);
+    }
+    return space;
+  }
+
+  // Filled slots as seen by the consumer.
+  size_t available(size_t head, size_t wanted) {
+    size_t available = m_cached_tail - head;
+    if (available < wanted) {
+      m_cached_tail = m_tail.load(std::memory_order_acquire);
+      available = m_cached_tail - head;
+    }
+    return available;
+  }
+
+  static void copy(T *to, const T *values, int count) {
+    if (std::is_trivially_copyable<T>::value) {
+      std::memcpy(static_cast<void *>(to), values, sizeof(T) * count);
+    } else {
+      for (int i = 0; i < count; i++) {
+        new (&to[i]) T(values[i]);
+      }
+    }
+  }
+
+  // Shared and read-only after construction.
+  alignas(cache_line) T *m_data;
+  int m_capacity;
+
+  // Written by the consumer.
+  alignas(cache_line) std::atomic<size_t> m_head;
+  size_t m_cached_tail;
+
+  // Written by the producer.
+  alignas(cache_line) std::atomic<size_t> m_tail;
+  size_t m_cached_head;
+};
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef VECTOR_SCAN_CPP
+#define VECTOR_SCAN_CPP
+
+#include <algorithm>
+
+// Scans over a contiguous array: find the first element equal to a value,
+// count the elements equal to a value, and find the minimum and maximum.
+// For any T these are plain loops; int, float and double get SSE2 and AVX2
+// kernels below, picked at runtime by what the CPU supports.
+//
+// min and max require n > 0 and use operator<, so a NaN is only ever
+// returned when it is the first element.
+template <typename T> struct ScalarScan {
+  static int find(const T *data, int n, const T &value) {
+    for (int i = 0; i < n; i++) {
+      if (data[i] == value) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  static int count(const T *data, int n, const T &value) {
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+      if (data[i] == value) {
+        count += 1;
+      }
+    }
+    return count;
+  }
+
+  static T min(const T *data, int n) {
+    T best = data[0];
+    for (int i = 1; i < n; i++) {
+      if (data[i] < best) {
+        best = data[i];
+      }
+    }
+    return best;
+  }
+
+  static T max(const T *data, int n) {
+    T best = data[0];
+    for (int i = 1; i < n; i++) {
+      if (best < data[i]) {
+        best = data[i];
+      }
+    }
+    return best;
+  }
+};
+
+template <typename T> struct VectorScan : ScalarScan<T> {};
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+
+// The kernels are written once against L, a Lanes<T> description of a vector
+// register. They are always inlined so that each one is compiled with the
+// instruction set of the wrapper that calls it. That also means no vector value
+// ever crosses a real call, so GCC's ABI note about AVX arguments is moot.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+template <typename L, typename T>
+inline __attribute__((always_inline)) int vector_find(const T *data, int n,
+                                                      T value) {
+  typename L::V needle = L::splat(value);
+  int i = 0;
+  for (; i + L::width <= n; i += L::width) {
+    int mask = L::equal(L::load(data + i), needle);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  for (; i < n; i++) {
+    if (data[i] == value) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+template <typename L, typename T>
+inline __attribute__((always_inline)) int vector_count(const T *data, int n,
+                                                       T value) {
+  typename L::V needle = L::splat(value);
+  int count = 0;
+  int i = 0;
+  for (; i + L::width <= n; i += L::width) {
+    count += __builtin_popcount(L::equal(L::load(data + i), needle));
+  }
+  for (; i < n; i++) {
+    count += data[i] == value;
+  }
+  return count;
+}
+
+// Folds whole vectors with L::min (or L::max), then the lanes and the tail
+// with scalar compares. Every lane starts from data[0] and the new block is
+// always the first operand, so a NaN anywhere but data[0] loses to the
+// running result, matching ScalarScan.
+template <typename L, typename T>
+inline __attribute__((always_inline)) T vector_min(const T *data, int n) {
+  typename L::V best = L::splat(data[0]);
+  int i = 0;
+  for (; i + L::width <= n; i += L::width) {
+    best = L::min(L::load(data + i), best);
+  }
+  T lanes[L::width];
+  L::store(lanes, best);
+  T result = ScalarScan<T>::min(lanes, L::width);
+  for (; i < n; i++) {
+    if (data[i] < result) {
+      result = data[i];
+    }
+  }
+  return result;
+}
+
+template <typename L, typename T>
+inline __attribute__((always_inline)) T vector_max(const T *data, int n) {
+  typename L::V best = L::splat(data[0]);
+  int i = 0;
+  for (; i + L::width <= n; i += L::width) {
+    best = L::max(L::load(data + i), best);
+  }
+  T lanes[L::width];
+  L::store(lanes, best);
+  T result = ScalarScan<T>::max(lanes, L::width);
+  for (; i < n; i++) {
+    if (result < data[i]) {
+      result = data[i];
+    }
+  }
+  return result;
+}
+#pragma GCC diagnostic pop
+
+namespace vector_scan_sse2 {
+template <typename T> struct Lanes;
+
+template <> struct Lanes<int> {
+  typedef __m128i V;
+  static const int width = 4;
+  static V load(const int *p) { return _mm_loadu_si128((const V *)p); }
+  static void store(int *p, V v) { _mm_storeu_si128((V *)p, v); }
+  static V splat(int v) { return _mm_set1_epi32(v); }
+  static int equal(V a, V b) {
+    return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b)));
+  }
+  // SSE2 has no 32-bit integer min/max, so select through a compare mask.
+  static V min(V a, V b) {
+    V less = _mm_cmplt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(less, a), _mm_andnot_si128(less, b));
+  }
+  static V max(V a, V b) {
+    V greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(greater, a),
+                        _mm_andnot_si128(greater, b));
+  }
+};
+
+template <> struct Lanes<float> {
+  typedef __m128 V;
+  static const int width = 4;
+  static V load(const float *p) { return _mm_loadu_ps(p); }
+  static void store(float *p, V v) { _mm_storeu_ps(p, v); }
+  static V splat(float v) { return _mm_set1_ps(v); }
+  static int equal(V a, V b) { return _mm_movemask_ps(_mm_cmpeq_ps(a, b)); }
+  static V min(V a, V b) { return _mm_min_ps(a, b); }
+  static V max(V a, V b) { return _mm_max_ps(a, b); }
+};
+
+template <> struct Lanes<double> {
+  typedef __m128d V;
+  static const int width = 2;
+  static V load(const double *p) { return _mm_loadu_pd(p); }
+  static void store(double *p, V v) { _mm_storeu_pd(p, v); }
+  static V splat(double v) { return _mm_set1_pd(v); }
+  static int equal(V a, V b) { return _mm_movemask_pd(_mm_cmpeq_pd(a, b)); }
+  static V min(V a, V b) { return _mm_min_pd(a, b); }
+  static V max(V a, V b) { return _mm_max_pd(a, b); }
+};
+
+} // namespace vector_scan_sse2
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace vector_scan_avx2 {
+template <typename T> struct Lanes;
+
+template <> struct Lanes<int> {
+  typedef __m256i V;
+  static const int width = 8;
+  static V load(const int *p) { return _mm256_loadu_si256((const V *)p); }
+  static void store(int *p, V v) { _mm256_storeu_si256((V *)p, v); }
+  static V splat(int v) { return _mm256_set1_epi32(v); }
+  static int equal(V a, V b) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)));
+  }
+  static V min(V a, V b) { return _mm256_min_epi32(a, b); }
+  static V max(V a, V b) { return _mm256_max_epi32(a, b); }
+};
+
+template <> struct Lanes<float> {
+  typedef __m256 V;
+  static const int width = 8;
+  static V load(const float *p) { return _mm256_loadu_ps(p); }
+  static void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+  static V splat(float v) { return _mm256_set1_ps(v); }
+  static int equal(V a, V b) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ));
+  }
+  static V min(V a, V b) { return _mm256_min_ps(a, b); }
+  static V max(V a, V b) { return _mm256_max_ps(a, b); }
+};
+
+template <> struct Lanes<double> {
+  typedef __m256d V;
+  static const int width = 4;
+  static V load(const double *p) { return _mm256_loadu_pd(p); }
+  static void store(double *p, V v) { _mm256_storeu_pd(p, v); }
+  static V splat(double v) { return _mm256_set1_pd(v); }
+  static int equal(V a, V b) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ));
+  }
+  static V min(V a, V b) { return _mm256_min_pd(a, b); }
+  static V max(V a, V b) { return _mm256_max_pd(a, b); }
+};
+
+template <typename T> int find(const T *data, int n, T value) {
+  return vector_find<Lanes<T> >(data, n, value);
+}
+
+template <typename T> int count(const T *data, int n, T value) {
+  return vector_count<Lanes<T> >(data, n, value);
+}
+
+template <typename T> T min(const T *data, int n) {
+  return vector_min<Lanes<T> >(data, n);
+}
+
+template <typename T> T max(const T *data, int n) {
+  return vector_max<Lanes<T> >(data, n);
+}
+} // namespace vector_scan_avx2
+#pragma GCC pop_options
+
+inline bool vector_scan_has_avx2() {
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+}
+
+template <typename T> struct VectorScanDispatch {
+  static int find(const T *data, int n, const T &value) {
+    if (vector_scan_has_avx2()) {
+      return vector_scan_avx2::find(data, n, value);
+    }
+    return vector_find<vector_scan_sse2::Lanes<T> >(data, n, value);
+  }
+
+  static int count(const T *data, int n, const T &value) {
+    if (vector_scan_has_avx2()) {
+      return vector_scan_avx2::count(data, n, value);
+    }
+    return vector_count<vector_scan_sse2::Lanes<T> >(data, n, value);
+  }
+
+  static T min(const T *data, int n) {
+    if (vector_scan_has_avx2()) {
+      return vector_scan_avx2::min(data, n);
+    }
+    return vector_min<vector_scan_sse2::Lanes<T> >(data, n);
+  }
+
+  static T max(const T *data, int n) {
+    if (vector_scan_has_avx2()) {
+      return vector_scan_avx2::max(data, n);
+    }
+    return vector_max<vector_scan_sse2::Lanes<T> >(data, n);
+  }
+};
+
+template <> struct VectorScan<int> : VectorScanDispatch<int> {};
+template <> struct VectorScan<float> : VectorScanDispatch<float> {};
+template <> struct VectorScan<double> : VectorScanDispatch<double> {};
+#endif
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef WORK_STEALING_DEQUE_CPP
+#define WORK_STEALING_DEQUE_CPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "RingCapacity.cpp"
+
+// A Chase-Lev work-stealing deque. One owner thread pushes and pops at the
+// bottom, like addEnd and delEnd on a CircularDynamicArray, while any number
+// of thief threads steal from the top, like delFront. The owner only pays for
+// a compare-and-swap when it races a thief for the last element.
+//
+// Slots are indexed like CircularDynamicArray's ring: a power-of-two buffer
+// and positions wrapped with a mask. top and bottom only grow, so the length
+// is bottom - top. When the buffer fills, push doubles it like resize does.
+// A thief may still be reading the old buffer at that moment, so old buffers
+// are kept until the deque is destroyed.
+//
+// T must be trivially copyable, since thieves read slots that the owner may
+// be overwriting; pointers or indices to tasks are the intended use.
+template <typename T> class WorkStealingDeque {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "WorkStealingDeque needs a trivially copyable T");
+
+public:
+  // Throws std::length_error if capacity is over max_ring_capacity.
+  explicit WorkStealingDeque(int capacity = 64) : m_top(0), m_bottom(0) {
+    Buffer *buffer = new Buffer(ring_capacity("WorkStealingDeque", capacity));
+    m_buffers.push_back(buffer);
+    m_buffer.store(buffer, std::memory_order_relaxed);
+  }
+
+  WorkStealingDeque(const WorkStealingDeque &) = delete;
+  WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+  ~WorkStealingDeque() {
+    for (size_t i = 0; i < m_buffers.size(); i++) {
+      delete m_buffers[i];
+    }
+  }
+
+  // Owner only. Throws std::length_error if the deque already holds
+  // max_ring_capacity elements.
+  void push(const T &value) {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+    Buffer *buffer = m_buffer.load(std::memory_order_relaxed);
+
+    if (bottom - top >= buffer->size) {
+      buffer = grow(buffer, top, bottom);
+    }
+
+    buffer->put(bottom, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only. Takes the most recently pushed element, or returns false if
+  // the deque is empty.
+  bool pop(T &out) {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    Buffer *buffer = m_buffer.load(std::memory_order_relaxed);
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    T value = buffer->get(bottom);
+    if (top == bottom) {
+      // The last element: whoever moves top first gets it.
+      bool won = m_top.compare_exchange_strong(top, top + 1,
+                                               std::memory_order_seq_cst,
+                                               std::memory_order_relaxed);
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+      if (!won) {
+        return false;
+      }
+    }
+    out = value;
+    return true;
+  }
+
+  // Any thread. Takes the least recently pushed element. Returns false if the
+  // deque is empty or another thread took that element first.
+  bool steal(T &out) {
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+    if (top >= bottom) {
+      return false;
+    }
+
+    Buffer *buffer = m_buffer.load(std::memory_order_acquire);
+    T value = buffer->get(top);
+    if (!m_top.compare_exchange_strong(top, top + 1,
+                                       std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+      return false;
+    }
+    out = value;
+    return true;
+  }
+
+  // Only exact when no other thread is using the deque.
+  int length() const {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+    return bottom > top ? bottom - top : 0;
+  }
+
+  int capacity() const {
+    return m_buffer.load(std::memory_order_relaxed)->size;
+  }
+
+private:
+  struct Buffer {
+    explicit Buffer(int size) : size(size), slots(new std::atomic<T>[size]) {}
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
+    ~Buffer() { delete[] slots; }
+
+    T get(int64_t i) const {
+      return slots[i & (size - 1)].load(std::memory_order_relaxed);
+    }
+    void put(int64_t i, const T &value) {
+      slots[i & (size - 1)].store(value, std::memory_order_relaxed);
+    }
+
+    int size;
+    std::atomic<T> *slots;
+  };
+
+  Buffer *grow(Buffer *old, int64_t top, int64_t bottom) {
+    if (old->size == max_ring_capacity) {
+      throw std::length_error("WorkStealingDeque: capacity limit reached");
+    }
+    Buffer *buffer = new Buffer(old->size * 2);
+    for (int64_t i = top; i < bottom; i++) {
+      buffer->put(i, old->get(i));
+    }
+    m_buffers.push_back(buffer);
+    m_buffer.store(buffer, std::memory_order_release);
+    return buffer;
+  }
+
+  alignas(64) std::atomic<int64_t> m_top;
+  alignas(64) std::atomic<int64_t> m_bottom;
+  std::atomic<Buffer *> m_buffer;
+
+  // Every buffer ever used, owned by the deque. Only the owner touches this.
+  std::vector<Buffer *> m_buffers;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <string>
+#include <unistd.h>
+using namespace std;
+#include "CircularDynamicArray.cpp"
+#include "IncrementalCircularDynamicArray.cpp"
+#include "MappedCircularDynamicArray.cpp"
+#include "SegmentedCircularDynamicArray.cpp"
+#include "SharedCircularDynamicArray.cpp"
+#include "SlidingQuantile.cpp"
+#include "SlidingWindow.cpp"
+#include "SpscRing.cpp"
+#include "WorkStealingDeque.cpp"
+
+template <typename Array> void print(Array &A) {
+	for (int i=0; i< A.length();i++) cout << A[i] << " ";
+	cout << endl;
+}
+
+int main(){
+	SlidingWindow<int, long long> W(4);
+	int samples[] = {5, 1, 7, 3, 9, 2};
+	for (int i=0; i<6; i++) {
+		W.push(samples[i]);
+		cout << W.min() << " " << W.max() << " " << W.sum() << " " << W.mean() << endl;
+	}
+	// W => "5 5 5 5", "1 5 6 3", "1 7 13 4.33333", "1 7 16 4", "1 9 20 5", "2 9 21 5.25"
+	W.pop();
+	cout << W.min() << " " << W.max() << " " << W.length() << endl;
+	// W => "2 9 3"
+
+	SlidingQuantile<int> Q(100);
+	for (int i=1; i<=200; i++) Q.push(i);
+	cout << Q.median() << " " << Q.quantile(0.99) << " " << Q.select(1) << " " << Q.rank(150) << endl;
+	// Q => "150 199 101 49"
+	Q.pop(); Q.pop();
+	cout << Q.select(1) << " " << Q.length() << endl;
+	// Q => "103 98"
+
+	SharedCircularDynamicArray<int> S;
+	for (int i=0; i<10; i++) S.addEnd(i);
+	SharedCircularDynamicArray<int> T = S;
+	cout << S.shared() << " " << (&S.array() == &T.array()) << endl;
+	// S => "1 1"
+	cout << T.get(9) << " " << T.shared() << endl;
+	// S => "9 1"
+	T.addFront(-1);
+	cout << S.shared() << " " << S.length() << " " << T.length() << endl;
+	// S => "0 10 11"
+
+	SegmentedCircularDynamicArray<int, 4> G;
+	for (int i=0; i<10; i++) G.addEnd(i);
+	for (int i=0; i<5; i++) G.addFront(-i-1);
+	print(G);
+	// G => "-5 -4 -3 -2 -1 0 1 2 3 4 5 6 7 8 9"
+	G.delFront(); G.delFront(); G.delEnd();
+	cout << G.length() << " " << G.capacity() << " " << G.linearSearch(4) << endl;
+	// G => "12 16 7"
+	G.Sort();
+	cout << G.binSearch(-1) << " " << G.binSearch(100) << endl;
+	// G => "2 -1"
+
+	IncrementalCircularDynamicArray<string> I(1);
+	for (int i=0; i<9; i++) I.addEnd(to_string(i));
+	I.addFront("a");
+	print(I);
+	// I => "a 0 1 2 3 4 5 6 7 8"
+	cout << I.capacity() << " " << I.migrating() << endl;
+	// I => "16 1"
+	for (int i=0; i<8; i++) I.delEnd();
+	print(I);
+	// I => "a 0"
+
+	const char *path = "WrappersMain.ring";
+	unlink(path);
+	{
+		MappedCircularDynamicArray<int> M(path, 4);
+		for (int i=0; i<6; i++) M.addEnd(i);
+		M.addFront(-1);
+		M.delEnd();
+	}
+	{
+		MappedCircularDynamicArray<int> M(path);
+		print(M);
+		// M => "-1 0 1 2 3 4"
+		cout << M.capacity() << endl;
+		// M => "8"
+	}
+	unlink(path);
+
+	SpscRing<int> R(4);
+	int batch[] = {1, 2, 3, 4, 5, 6};
+	cout << R.pushBatch(batch, 6) << " ";
+	int popped[6];
+	cout << R.popBatch(popped, 6) << " " << popped[3] << endl;
+	// R => "4 4 4"
+
+	WorkStealingDeque<int> D(2);
+	for (int i=0; i<5; i++) D.push(i);
+	int x = -1, y = -1;
+	bool took = D.pop(x), stole = D.steal(y);
+	cout << took << " " << stole << " " << x << " " << y << " " << D.length() << " " << D.capacity() << endl;
+	// D => "1 1 4 0 3 8"
+
+	CircularDynamicArray<int, PoolAllocator<int> > P;
+	for (int i=0; i<100; i++) P.addFront(i);
+	P.Sort();
+	cout << P[0] << " " << P[99] << " " << P.binSearch(42) << endl;
+	// P => "0 99 42"
+}
@@ -1,20 +1,36 @@
 #include <iostream>
 
-template <typename T> class CircularDynamicArray {
+// Storage for the first N elements of a CircularDynamicArray, held inside
+// the array object itself.
+template <typename T, int N> struct InlineBuffer {
+  T *data() { return m_data; }
+
+  T m_data[N];
+};
+
+template <typename T> struct InlineBuffer<T, 0> {
+  T *data() { return nullptr; }
+};
+
+// With N > 0 the first N elements are stored inline, and the heap is only
+// used once the array outgrows them. A capacity of at most N always means
+// the inline buffer, so the array never shrinks below N.
+template <typename T, int N = 0> class CircularDynamicArray {
 public:
-  CircularDynamicArray() : m_capacity(2), m_length(0), m_start(0) {
-    m_data = new T[m_capacity];
+  CircularDynamicArray()
+      : m_capacity(N > 0 ? N : 2), m_length(0), m_start(0) {
+    m_data = allocate(m_capacity);
   }
 
   CircularDynamicArray(int size)
-      : m_capacity(size), m_length(0), m_start(0) {
-    m_data = new T[m_capacity];
+      : m_capacity(N > size ? N : size), m_length(0), m_start(0) {
+    m_data = allocate(m_capacity);
   }
 
   CircularDynamicArray(const CircularDynamicArray &old)
       : m_capacity(old.m_capacity), m_length(old.m_length),
         m_start(old.m_start) {
-    m_data = new T[m_capacity];
+    m_data = allocate(m_capacity);
 
     for (int i = 0; i < m_length; i++) {
       int index = internal_index(i);
@@ -27,12 +43,12 @@ public:
       return *this;
     }
 
-    delete[] m_data;
+    release(m_data);
 
     m_start = rhs.m_start;
     m_length = rhs.m_length;
     m_capacity = rhs.m_capacity;
-    m_data = new T[m_capacity];
+    m_data = allocate(m_capacity);
 
     for (int i = 0; i < m_length; i++) {
       int index = internal_index(i);
@@ -42,7 +58,7 @@ public:
     return *this;
   }
 
-  ~CircularDynamicArray() { delete[] m_data; }
+  ~CircularDynamicArray() { release(m_data); }
 
   T &operator[](int i) {
     if (i >= m_length) {
@@ -106,10 +122,10 @@ public:
   int capacity() const { return m_capacity; }
 
   void clear() {
-    delete[] m_data;
+    release(m_data);
 
-    m_data = new T[2];
-    m_capacity = 2;
+    m_capacity = N > 0 ? N : 2;
+    m_data = allocate(m_capacity);
     m_length = 0;
     m_start = 0;
   }
@@ -155,7 +171,7 @@ public:
   }
 
   void Sort() {
-    CircularDynamicArray<T> temp(*this);
+    CircularDynamicArray temp(*this);
     merge_sort(temp, *this, 0, m_length);
   }
 
@@ -224,13 +240,30 @@ private:
 
   T &index(int i) { return m_data[internal_index(i)]; }
 
+  T *allocate(int size) {
+    return size <= N ? m_inline.data() : new T[size];
+  }
+
+  void release(T *data) {
+    if (data != m_inline.data()) {
+      delete[] data;
+    }
+  }
+
   void resize(int size) {
+    if (size < N) {
+      size = N;
+    }
+    if (size == m_capacity) {
+      return;
+    }
+
     T *old = m_data;
-    m_data = new T[size];
+    m_data = allocate(size);
     for (int i = 0; i < m_length; i++) {
       m_data[i] = old[(m_start + i) % m_capacity];
     }
-    delete[] old;
+    release(old);
 
     m_capacity = size;
     m_start = 0;
@@ -241,6 +274,7 @@ private:
   int m_capacity;
   int m_length;
   int m_start;
+  InlineBuffer<T, N> m_inline;
 
   T dummy;
 };
\ No newline at end of file
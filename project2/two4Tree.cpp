@@ -12,7 +12,8 @@ public:
   }
 
 public:
-  CircularDynamicArray<V> m_values;
+  // Most keys hold a single value, which then lives in the element itself.
+  CircularDynamicArray<V, 1> m_values;
   K m_key;
 };
 